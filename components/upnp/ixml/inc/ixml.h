@@ -147,6 +147,7 @@ typedef enum
     IXML_INVALID_PARAMETER              = 105,
     IXML_FAILED                         = 106,
     IXML_INVALID_ITEM_NUMBER            = 107,
+    IXML_SAX_STOPPED                    = 108,
 
 } IXML_ERRORCODE;
 
@@ -186,6 +187,7 @@ typedef struct _IXML_Node
 typedef struct _IXML_Document
 {
     IXML_Node    n;
+    struct _IXML_Arena *arena;  // backs the nodes of parsed documents
 } IXML_Document;
 
 typedef struct _IXML_CDATASection
@@ -225,6 +227,30 @@ typedef struct _IXML_NamedNodeMap
     struct _IXML_NamedNodeMap *next;
 } IXML_NamedNodeMap;
 
+/*================================================================
+*
+*   streaming (SAX style) parser data structures
+*
+*
+*=================================================================*/
+typedef struct _IXML_SaxElement
+{
+    const char      *nodeName;      // qualified name, as in the tag
+    const char      *prefix;        // NULL if unprefixed
+    const char      *localName;
+    const char      *namespaceURI;  // resolved, NULL if none in scope
+    int             depth;          // 1 for the document element
+    size_t          offset;         // start: offset of '<' of the start tag
+                                    // end: offset just past the end tag
+} IXML_SaxElement;
+
+typedef struct _IXML_SaxHandler
+{
+    int (*startElement)( void *cookie, const IXML_SaxElement *element );
+    int (*characters)( void *cookie, const char *text, int depth );
+    int (*endElement)( void *cookie, const IXML_SaxElement *element );
+} IXML_SaxHandler;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -1815,7 +1841,25 @@ EXPORT_SPEC void
 ixmlRelaxParser(char errorChar);
 
 
+  /** Selects how the nodes of parsed documents are allocated.
+   *
+   * If {\bf enable} is {\tt TRUE} (default), each parsed {\bf Document}
+   * carves its nodes and strings from an arena of its own, which
+   * {\bf ixmlDocument_free} releases in one go.  If {\tt FALSE}, every
+   * node and string is a separate heap block, as with documents built
+   * through the {\bf ixmlDocument_create*} functions.
+   */
+EXPORT_SPEC void
+ixmlArenaParser(BOOL enable);
+
+
   /** Parses an XML text buffer converting it into an IXML DOM representation.
+   *
+   *  The nodes and strings of a parsed {\bf Document} are allocated from
+   *  an arena owned by the document and released at once by
+   *  {\bf ixmlDocument_free}.  A node removed from such a document must be
+   *  freed before the document, or copied with {\bf ixmlNode_cloneNode}
+   *  if it has to outlive it.
    *
    *  @return [Document*] A {\bf Document} if the buffer correctly parses or 
    *                      {\tt NULL} on an error. 
@@ -1852,6 +1896,40 @@ ixmlParseBufferEx(const char *buffer,
 		        parses or {\bf NULL} on an error. */
                 );
 
+  /** Parses an XML text buffer without building a DOM, reporting each
+   *  element and each piece of character data to {\bf handler} as it is
+   *  read.  Attributes are not reported; namespace declarations are
+   *  applied to the {\tt namespaceURI} of the elements they scope.  The
+   *  strings passed to the callbacks are only valid during the call.
+   *
+   *  The element offsets are relative to {\bf buffer}, so a callback can
+   *  cut a subtree out of it, e.g. to hand it to {\bf ixmlParseBufferEx}.
+   *  A callback returns {\tt IXML_SUCCESS} to continue; any other value
+   *  stops the parse and is returned as is.  Any callback may be
+   *  {\tt NULL}.
+   *
+   *  @return [int] An integer representing one of the following:
+   *    \begin{itemize}
+   *      \item {\tt IXML_SUCCESS}: The whole buffer was parsed.
+   *      \item {\tt IXML_INVALID_PARAMETER}: The {\bf buffer} or 
+   *            {\bf handler} is not a valid pointer.
+   *      \item {\tt IXML_SYNTAX_ERR}: The buffer is not well formed.
+   *      \item {\tt IXML_INSUFFICIENT_MEMORY}: Not enough free memory 
+   *            exists to complete this operation.
+   *      \item the value returned by a callback that stopped the parse, 
+   *            conventionally {\tt IXML_SAX_STOPPED}.
+   *    \end{itemize}
+   */
+
+EXPORT_SPEC int
+ixmlParseBufferSax(const char *buffer,
+		     /** The buffer that contains the XML text to scan. */
+                   const IXML_SaxHandler *handler,
+		     /** The callbacks to invoke. */
+                   void *cookie
+		     /** Passed unchanged to every callback. */
+                  );
+
   /** Parses an XML text file converting it into an IXML DOM representation.
    *
    *  @return [Document*] A {\bf Document} if the file correctly parses or 
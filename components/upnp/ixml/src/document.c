@@ -61,6 +61,24 @@ ixmlDocument_free( IN IXML_Document * doc )
 
 }
 
+/*================================================================
+*   ixmlDocument_allocMem
+*       Allocates memory for a node of the document: from the
+*       document arena when it has one, from the heap otherwise.
+*       Internal function.
+*
+*=================================================================*/
+void *
+ixmlDocument_allocMem( IN IXML_Document * doc,
+                       IN size_t size )
+{
+    if( ( doc != NULL ) && ( doc->arena != NULL ) ) {
+        return ixmlArena_alloc( doc->arena, size );
+    }
+
+    return os_alloc( size );
+}
+
 /*================================================================
 *   ixmlDocument_setOwnerDocument
 *       
@@ -161,14 +179,17 @@ ixmlDocument_createElementEx( IN IXML_Document * doc,
     }
 
     //newElement = ( IXML_Element * ) malloc( sizeof( IXML_Element ) );
-    newElement = ( IXML_Element * ) os_alloc( sizeof( IXML_Element ) );
+    newElement =
+        ( IXML_Element * ) ixmlDocument_allocMem( doc,
+                                                  sizeof( IXML_Element ) );
     if( newElement == NULL ) {
         errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
 
     ixmlElement_init( newElement );
-    newElement->tagName = strdup( tagName );
+    newElement->n.ownerDocument = doc;
+    newElement->tagName = ixmlNode_strdup( &newElement->n, tagName );
     if( newElement->tagName == NULL ) {
         ixmlElement_free( newElement );
         newElement = NULL;
@@ -177,7 +198,7 @@ ixmlDocument_createElementEx( IN IXML_Document * doc,
     }
     // set the node fields 
     newElement->n.nodeType = eELEMENT_NODE;
-    newElement->n.nodeName = strdup( tagName );
+    newElement->n.nodeName = ixmlNode_strdup( &newElement->n, tagName );
     if( newElement->n.nodeName == NULL ) {
         ixmlElement_free( newElement );
         newElement = NULL;
@@ -185,8 +206,6 @@ ixmlDocument_createElementEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    newElement->n.ownerDocument = doc;
-
   ErrorHandler:
     *rtElement = newElement;
     return errCode;
@@ -307,15 +326,17 @@ ixmlDocument_createTextNodeEx( IN IXML_Document * doc,
     }
 
     //returnNode = ( IXML_Node * ) malloc( sizeof( IXML_Node ) );
-    returnNode = ( IXML_Node * ) os_alloc( sizeof( IXML_Node ) );
+    returnNode = ( IXML_Node * ) ixmlDocument_allocMem( doc,
+                                                        sizeof( IXML_Node ) );
     if( returnNode == NULL ) {
         rc = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
     // initialize the node
     ixmlNode_init( returnNode );
+    returnNode->ownerDocument = doc;
 
-    returnNode->nodeName = strdup( TEXTNODENAME );
+    returnNode->nodeName = ixmlNode_strdup( returnNode, TEXTNODENAME );
     if( returnNode->nodeName == NULL ) {
         ixmlNode_free( returnNode );
         returnNode = NULL;
@@ -324,7 +345,7 @@ ixmlDocument_createTextNodeEx( IN IXML_Document * doc,
     }
     // add in node value
     if( data != NULL ) {
-        returnNode->nodeValue = strdup( data );
+        returnNode->nodeValue = ixmlNode_strdup( returnNode, data );
         if( returnNode->nodeValue == NULL ) {
             ixmlNode_free( returnNode );
             returnNode = NULL;
@@ -334,7 +355,6 @@ ixmlDocument_createTextNodeEx( IN IXML_Document * doc,
     }
 
     returnNode->nodeType = eTEXT_NODE;
-    returnNode->ownerDocument = doc;
 
   ErrorHandler:
     *textNode = returnNode;
@@ -382,26 +402,26 @@ ixmlDocument_createAttributeEx( IN IXML_Document * doc,
     IXML_Attr *attrNode = NULL;
     int errCode = IXML_SUCCESS;
 
-    //attrNode = ( IXML_Attr * ) malloc( sizeof( IXML_Attr ) );
-    attrNode = ( IXML_Attr * ) os_alloc( sizeof( IXML_Attr ) );
-    if( attrNode == NULL ) {
-        errCode = IXML_INSUFFICIENT_MEMORY;
+    if( ( doc == NULL ) || ( name == NULL ) ) {
+        errCode = IXML_INVALID_PARAMETER;
         goto ErrorHandler;
     }
 
-    if( ( doc == NULL ) || ( name == NULL ) ) {
-        ixmlAttr_free( attrNode );
-        attrNode = NULL;
-        errCode = IXML_INVALID_PARAMETER;
+    //attrNode = ( IXML_Attr * ) malloc( sizeof( IXML_Attr ) );
+    attrNode = ( IXML_Attr * ) ixmlDocument_allocMem( doc,
+                                                      sizeof( IXML_Attr ) );
+    if( attrNode == NULL ) {
+        errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
     }
 
     ixmlAttr_init( attrNode );
 
     attrNode->n.nodeType = eATTRIBUTE_NODE;
+    attrNode->n.ownerDocument = doc;
 
     // set the node fields
-    attrNode->n.nodeName = strdup( name );
+    attrNode->n.nodeName = ixmlNode_strdup( &attrNode->n, name );
     if( attrNode->n.nodeName == NULL ) {
         ixmlAttr_free( attrNode );
         attrNode = NULL;
@@ -409,8 +429,6 @@ ixmlDocument_createAttributeEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    attrNode->n.ownerDocument = doc;
-
   ErrorHandler:
     *rtAttr = attrNode;
     return errCode;
@@ -474,7 +492,7 @@ ixmlDocument_createAttributeNSEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
     // set the namespaceURI field 
-    attrNode->n.namespaceURI = strdup( namespaceURI );
+    attrNode->n.namespaceURI = ixmlNode_strdup( &attrNode->n, namespaceURI );
     if( attrNode->n.namespaceURI == NULL ) {
         ixmlAttr_free( attrNode );
         attrNode = NULL;
@@ -548,7 +566,9 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
 
     cDSectionNode =
         //( IXML_CDATASection * ) malloc( sizeof( IXML_CDATASection ) );
-        ( IXML_CDATASection * ) os_alloc( sizeof( IXML_CDATASection ) );
+        ( IXML_CDATASection * ) ixmlDocument_allocMem( doc,
+                                                       sizeof
+                                                       ( IXML_CDATASection ) );
     if( cDSectionNode == NULL ) {
         errCode = IXML_INSUFFICIENT_MEMORY;
         goto ErrorHandler;
@@ -557,7 +577,9 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
     ixmlCDATASection_init( cDSectionNode );
 
     cDSectionNode->n.nodeType = eCDATA_SECTION_NODE;
-    cDSectionNode->n.nodeName = strdup( CDATANODENAME );
+    cDSectionNode->n.ownerDocument = doc;
+    cDSectionNode->n.nodeName =
+        ixmlNode_strdup( &cDSectionNode->n, CDATANODENAME );
     if( cDSectionNode->n.nodeName == NULL ) {
         ixmlCDATASection_free( cDSectionNode );
         cDSectionNode = NULL;
@@ -565,7 +587,7 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    cDSectionNode->n.nodeValue = strdup( data );
+    cDSectionNode->n.nodeValue = ixmlNode_strdup( &cDSectionNode->n, data );
     if( cDSectionNode->n.nodeValue == NULL ) {
         ixmlCDATASection_free( cDSectionNode );
         cDSectionNode = NULL;
@@ -573,8 +595,6 @@ ixmlDocument_createCDATASectionEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
 
-    cDSectionNode->n.ownerDocument = doc;
-
   ErrorHandler:
     *rtCD = cDSectionNode;
     return errCode;
@@ -638,7 +658,8 @@ ixmlDocument_createElementNSEx( IN IXML_Document * doc,
         goto ErrorHandler;
     }
     // set the namespaceURI field 
-    newElement->n.namespaceURI = strdup( namespaceURI );
+    newElement->n.namespaceURI =
+        ixmlNode_strdup( &newElement->n, namespaceURI );
     if( newElement->n.namespaceURI == NULL ) {
         ixmlElement_free( newElement );
         newElement = NULL;
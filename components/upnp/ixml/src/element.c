@@ -81,10 +81,10 @@ ixmlElement_setTagName( IN IXML_Element * element,
     }
 
     if( element->tagName != NULL ) {
-        free( element->tagName );
+        ixmlNode_freeMem( &element->n, element->tagName );
     }
 
-    element->tagName = strdup( tagName );
+    element->tagName = ixmlNode_strdup( &element->n, tagName );
     if( element->tagName == NULL ) {
         rc = IXML_INSUFFICIENT_MEMORY;
     }
@@ -179,7 +179,7 @@ ixmlElement_setAttribute( IN IXML_Element * element,
 
         attrNode = ( IXML_Node * ) newAttrNode;
 
-        attrNode->nodeValue = strdup( value );
+        attrNode->nodeValue = ixmlNode_strdup( attrNode, value );
         if( attrNode->nodeValue == NULL ) {
             ixmlAttr_free( newAttrNode );
             errCode = IXML_INSUFFICIENT_MEMORY;
@@ -195,10 +195,10 @@ ixmlElement_setAttribute( IN IXML_Element * element,
 
     } else {
         if( attrNode->nodeValue != NULL ) { // attribute name has a value already
-            free( attrNode->nodeValue );
+            ixmlNode_freeMem( attrNode, attrNode->nodeValue );
         }
 
-        attrNode->nodeValue = strdup( value );
+        attrNode->nodeValue = ixmlNode_strdup( attrNode, value );
         if( attrNode->nodeValue == NULL ) {
             errCode = IXML_INSUFFICIENT_MEMORY;
         }
@@ -241,7 +241,7 @@ ixmlElement_removeAttribute( IN IXML_Element * element,
 
     if( attrNode != NULL ) {    // has the attribute
         if( attrNode->nodeValue != NULL ) {
-            free( attrNode->nodeValue );
+            ixmlNode_freeMem( attrNode, attrNode->nodeValue );
             attrNode->nodeValue = NULL;
         }
     }
@@ -607,22 +607,23 @@ ixmlElement_setAttributeNS( IN IXML_Element * element,
 
     if( attrNode != NULL ) {
         if( attrNode->prefix != NULL ) {
-            free( attrNode->prefix );   // remove the old prefix
+            ixmlNode_freeMem( attrNode, attrNode->prefix );     // remove the old prefix
         }
         // replace it with the new prefix
-        attrNode->prefix = strdup( newAttrNode.prefix );
+        attrNode->prefix = ixmlNode_strdup( attrNode, newAttrNode.prefix );
         if( attrNode->prefix == NULL ) {
             Parser_freeNodeContent( &newAttrNode );
             return IXML_INSUFFICIENT_MEMORY;
         }
 
         if( attrNode->nodeValue != NULL ) {
-            free( attrNode->nodeValue );
+            ixmlNode_freeMem( attrNode, attrNode->nodeValue );
         }
 
-        attrNode->nodeValue = strdup( value );
+        attrNode->nodeValue = ixmlNode_strdup( attrNode, value );
         if( attrNode->nodeValue == NULL ) {
-            free( attrNode->prefix );
+            ixmlNode_freeMem( attrNode, attrNode->prefix );
+            attrNode->prefix = NULL;
             Parser_freeNodeContent( &newAttrNode );
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -637,7 +638,7 @@ ixmlElement_setAttributeNS( IN IXML_Element * element,
             return rc;
         }
 
-        newAttr->n.nodeValue = strdup( value );
+        newAttr->n.nodeValue = ixmlNode_strdup( &newAttr->n, value );
         if( newAttr->n.nodeValue == NULL ) {
             ixmlAttr_free( newAttr );
             return IXML_INSUFFICIENT_MEMORY;
@@ -694,7 +695,7 @@ ixmlElement_removeAttributeNS( IN IXML_Element * element,
 
     if( attrNode != NULL ) {    // has the attribute
         if( attrNode->nodeValue != NULL ) {
-            free( attrNode->nodeValue );
+            ixmlNode_freeMem( attrNode, attrNode->nodeValue );
             attrNode->nodeValue = NULL;
         }
     }
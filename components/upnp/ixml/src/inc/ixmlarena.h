@@ -0,0 +1,47 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Per-document bump allocator used by the ixml parser.
+//
+// Nodes and strings of a parsed document are carved out of a short list
+// of large chunks instead of one heap block each, and are all released
+// at once when the document is freed.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#ifndef _IXML_ARENA_H
+#define _IXML_ARENA_H
+
+#include <stdlib.h>
+#include "ixml.h"
+
+// size of the first chunk; each following chunk doubles up to the max
+#define IXML_ARENA_CHUNK_SIZE       512
+#define IXML_ARENA_MAX_CHUNK_SIZE   8192
+
+// alignment of every block handed out by the arena
+#define IXML_ARENA_ALIGN            sizeof( void * )
+
+typedef struct _IXML_ArenaChunk
+{
+    struct _IXML_ArenaChunk *next;
+    size_t                  size;       // usable bytes after the header
+    size_t                  used;
+} IXML_ArenaChunk;
+
+typedef struct _IXML_Arena
+{
+    IXML_ArenaChunk *chunks;            // head is the chunk being filled
+    size_t          nextSize;
+} IXML_Arena;
+
+//--------------------------------------------------
+//////////////// functions /////////////////////////
+//--------------------------------------------------
+
+IXML_Arena *ixmlArena_new( void );
+void ixmlArena_free( INOUT IXML_Arena *arena );
+void *ixmlArena_alloc( INOUT IXML_Arena *arena, IN size_t size );
+char *ixmlArena_strdup( INOUT IXML_Arena *arena, IN const char *s );
+BOOL ixmlArena_owns( IN const IXML_Arena *arena, IN const void *p );
+
+#endif // _IXML_ARENA_H
@@ -34,6 +34,7 @@
 
 #include "ixml.h"
 #include "ixmlmembuf.h"
+#include "ixmlarena.h"
 
 // Parser definitions
 #define QUOT        "&quot;"
@@ -74,6 +75,7 @@ typedef struct _Parser
     char            *dataBuffer;	//data buffer
     char            *curPtr;		//ptr to the token parsed 
     char            *savePtr;		//Saves for backup
+    char            *tagStart;		//start of the last markup token
     ixml_membuf     lastElem;
     ixml_membuf     tokenBuf;    
 
@@ -89,11 +91,13 @@ typedef struct _Parser
 
 
 int     Parser_LoadDocument( IXML_Document **retDoc, const char * xmlFile, BOOL file);
+int     Parser_SaxDocument( const char *buffer, const IXML_SaxHandler *handler, void *cookie);
 BOOL    Parser_isValidXmlName( const DOMString name);
 int     Parser_setNodePrefixAndLocalName(IXML_Node *newIXML_NodeIXML_Attr);
 void    Parser_freeNodeContent( IXML_Node *IXML_Nodeptr);
 
 void    Parser_setErrorChar( char c );
+void    Parser_setUseArena( BOOL enable );
 
 void    ixmlAttr_free(IXML_Attr *attrNode);
 void    ixmlAttr_init(IXML_Attr *attrNode);
@@ -103,7 +107,11 @@ int     ixmlElement_setTagName(IXML_Element *element, const char *tagName);
 void    ixmlNamedNodeMap_init(IXML_NamedNodeMap *nnMap);
 int     ixmlNamedNodeMap_addToNamedNodeMap(IXML_NamedNodeMap **nnMap, IXML_Node *add);
 
+void    *ixmlDocument_allocMem(IXML_Document *doc, size_t size);
+
 void    ixmlNode_init(IXML_Node *IXML_Nodeptr);
+char    *ixmlNode_strdup(IXML_Node *node, const char *s);
+void    ixmlNode_freeMem(IXML_Node *node, void *p);
 BOOL    ixmlNode_compare(IXML_Node *srcIXML_Node, IXML_Node *destIXML_Node);
 
 void    ixmlNode_getElementsByTagName( IXML_Node *n, const char *tagname, IXML_NodeList **list);
@@ -462,6 +462,17 @@ ixmlRelaxParser(char errorChar)
     Parser_setErrorChar( errorChar );
 }
 
+/*================================================================
+*   ixmlArenaParser
+*       Selects whether parsed documents use a per-document arena.
+*       External function.
+*
+*=================================================================*/
+void
+ixmlArenaParser(BOOL enable)
+{
+    Parser_setUseArena( enable );
+}
 
 /*================================================================
 *   ixmlParseBufferEx
@@ -500,6 +511,30 @@ ixmlParseBuffer( IN const char *buffer )
     return doc;
 }
 
+/*================================================================
+*   ixmlParseBufferSax
+*       Scans xml stored in buffer, reporting elements and text to
+*       the handler without building a DOM.
+*       External function.
+*
+*=================================================================*/
+int
+ixmlParseBufferSax( IN const char *buffer,
+                    IN const IXML_SaxHandler * handler,
+                    IN void *cookie )
+{
+
+    if( ( buffer == NULL ) || ( handler == NULL ) ) {
+        return IXML_INVALID_PARAMETER;
+    }
+
+    if( buffer[0] == '\0' ) {
+        return IXML_INVALID_PARAMETER;
+    }
+
+    return Parser_SaxDocument( buffer, handler, cookie );
+}
+
 /*================================================================
 *   ixmlCloneDOMString
 *       Clones a DOM String.
@@ -0,0 +1,200 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Per-document bump allocator used by the ixml parser.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ixmlarena.h"
+
+#define CHUNK_DATA( c ) ( ( char * )( c ) + sizeof( IXML_ArenaChunk ) )
+
+/*================================================================
+*   ixmlArena_newChunk
+*       Allocates a chunk with room for 'size' bytes.
+*       Internal to arena only.
+*
+*=================================================================*/
+static IXML_ArenaChunk *
+ixmlArena_newChunk( IN size_t size )
+{
+    IXML_ArenaChunk *chunk;
+
+    chunk = ( IXML_ArenaChunk * ) os_alloc( sizeof( IXML_ArenaChunk ) +
+                                            size );
+    if( chunk == NULL ) {
+        return NULL;
+    }
+
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = 0;
+
+    return chunk;
+}
+
+/*================================================================
+*   ixmlArena_new
+*       Creates an empty arena. No chunk is allocated until the
+*       first allocation.
+*
+*   returns:
+*       the arena or NULL if out of memory
+*
+*=================================================================*/
+IXML_Arena *
+ixmlArena_new( void )
+{
+    IXML_Arena *arena;
+
+    arena = ( IXML_Arena * ) os_alloc( sizeof( IXML_Arena ) );
+    if( arena == NULL ) {
+        return NULL;
+    }
+
+    arena->chunks = NULL;
+    arena->nextSize = IXML_ARENA_CHUNK_SIZE;
+
+    return arena;
+}
+
+/*================================================================
+*   ixmlArena_free
+*       Releases every chunk of the arena and the arena itself.
+*
+*=================================================================*/
+void
+ixmlArena_free( INOUT IXML_Arena * arena )
+{
+    IXML_ArenaChunk *chunk,
+     *next;
+
+    if( arena == NULL ) {
+        return;
+    }
+
+    chunk = arena->chunks;
+    while( chunk != NULL ) {
+        next = chunk->next;
+        os_free( chunk );
+        chunk = next;
+    }
+
+    os_free( arena );
+}
+
+/*================================================================
+*   ixmlArena_alloc
+*       Returns 'size' bytes from the current chunk, starting a new
+*       chunk when it is full. Requests larger than a quarter of a
+*       chunk get a chunk of their own, linked behind the current
+*       one so the free space left in it is not wasted.
+*
+*   returns:
+*       pointer to the block or NULL if out of memory
+*
+*=================================================================*/
+void *
+ixmlArena_alloc( INOUT IXML_Arena * arena,
+                 IN size_t size )
+{
+    IXML_ArenaChunk *chunk;
+    void *p;
+
+    assert( arena != NULL );
+
+    size = ( size + IXML_ARENA_ALIGN - 1 ) & ~( IXML_ARENA_ALIGN - 1 );
+    if( size == 0 ) {
+        size = IXML_ARENA_ALIGN;
+    }
+
+    chunk = arena->chunks;
+    if( chunk != NULL && chunk->size - chunk->used >= size ) {
+        p = CHUNK_DATA( chunk ) + chunk->used;
+        chunk->used += size;
+        return p;
+    }
+
+    if( chunk != NULL && size > arena->nextSize / 4 ) {
+        // oversized block: keep filling the current chunk afterwards
+        chunk = ixmlArena_newChunk( size );
+        if( chunk == NULL ) {
+            return NULL;
+        }
+        chunk->used = size;
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+        return CHUNK_DATA( chunk );
+    }
+
+    chunk = ixmlArena_newChunk( size > arena->nextSize ?
+                                size : arena->nextSize );
+    if( chunk == NULL ) {
+        return NULL;
+    }
+
+    chunk->used = size;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+
+    if( arena->nextSize < IXML_ARENA_MAX_CHUNK_SIZE ) {
+        arena->nextSize *= 2;
+    }
+
+    return CHUNK_DATA( chunk );
+}
+
+/*================================================================
+*   ixmlArena_strdup
+*       strdup() into the arena. NULL is duplicated as "" like the
+*       parser's safe_strdup.
+*
+*=================================================================*/
+char *
+ixmlArena_strdup( INOUT IXML_Arena * arena,
+                  IN const char *s )
+{
+    size_t len;
+    char *p;
+
+    if( s == NULL ) {
+        s = "";
+    }
+
+    len = strlen( s ) + 1;
+    p = ( char * )ixmlArena_alloc( arena, len );
+    if( p != NULL ) {
+        memcpy( p, s, len );
+    }
+
+    return p;
+}
+
+/*================================================================
+*   ixmlArena_owns
+*       Tells whether 'p' was handed out by this arena. Used by the
+*       DOM free routines to skip arena memory, so nodes that were
+*       cloned or imported onto the heap can live in the same tree.
+*
+*=================================================================*/
+BOOL
+ixmlArena_owns( IN const IXML_Arena * arena,
+                IN const void *p )
+{
+    const IXML_ArenaChunk *chunk;
+    const char *c = ( const char * )p;
+
+    if( arena == NULL || p == NULL ) {
+        return FALSE;
+    }
+
+    for( chunk = arena->chunks; chunk != NULL; chunk = chunk->next ) {
+        if( c >= CHUNK_DATA( chunk ) && c < CHUNK_DATA( chunk ) + chunk->size ) {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
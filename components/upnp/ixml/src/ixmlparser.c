@@ -37,6 +37,7 @@
 #endif
 
 static char g_error_char = '\0';
+static BOOL g_use_arena = TRUE;
 
 static const char LESSTHAN = '<';
 static const char GREATERTHAN = '>';
@@ -366,6 +367,20 @@ Parser_setErrorChar( IN char c )
      g_error_char = c;
 }
 
+/*==============================================================================*
+*   Parser_setUseArena
+*       If 'enable' is TRUE (default), parsed documents allocate their
+*       nodes from a per-document arena; otherwise every node and string
+*       is a separate heap block.
+*       External function.
+*
+*===============================================================================*/
+void
+Parser_setUseArena( IN BOOL enable )
+{
+     g_use_arena = enable;
+}
+
 
 /*==============================================================================*
 *   Parser_intToUTF8:	
@@ -934,6 +949,15 @@ Parser_parseDocument( OUT IXML_Document ** retDoc,
         goto ErrorHandler;
     }
 
+    // every node of the tree is carved from the document arena
+    if( g_use_arena ) {
+        gRootDoc->arena = ixmlArena_new(  );
+        if( gRootDoc->arena == NULL ) {
+            rc = IXML_INSUFFICIENT_MEMORY;
+            goto ErrorHandler;
+        }
+    }
+
     xmlParser->currentNodePtr = ( IXML_Node * ) gRootDoc;
 
     rc = Parser_skipProlog( xmlParser );
@@ -1045,6 +1069,223 @@ ErrorHandler:
 
 }
 
+/*================================================================
+*   Parser_saxNamespace
+*       Resolves the namespace of an element from the element stack,
+*       innermost declaration first.
+*       Internal to parser only.
+*
+*=================================================================*/
+static const char *
+Parser_saxNamespace( IN Parser * xmlParser,
+                     IN IXML_Node * node )
+{
+    IXML_ElementStack *pCur;
+    IXML_NamespaceURI *pNsUri;
+
+    if( node->prefix == NULL ) {
+        // like the DOM builder, only the element's own xmlns applies
+        return xmlParser->pCurElement->namespaceUri;
+    }
+
+    for( pCur = xmlParser->pCurElement; pCur != NULL;
+         pCur = pCur->nextElement ) {
+        if( ( pCur->prefix != NULL ) && ( pCur->namespaceUri != NULL ) &&
+            ( strcmp( pCur->prefix, node->prefix ) == 0 ) ) {
+            return pCur->namespaceUri;
+        }
+
+        for( pNsUri = pCur->pNsURI; pNsUri != NULL;
+             pNsUri = pNsUri->nextNsURI ) {
+            if( strcmp( pNsUri->prefix, node->prefix ) == 0 ) {
+                return pNsUri->nsURI;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/*================================================================
+*   Parser_saxElement
+*       Fills in the element description passed to the SAX callbacks.
+*       The element must be the top of the element stack.
+*       Internal to parser only.
+*
+*=================================================================*/
+static int
+Parser_saxElement( IN Parser * xmlParser,
+                   IN IXML_Node * node,
+                   IN int depth,
+                   IN size_t offset,
+                   OUT IXML_SaxElement * element )
+{
+    int rc;
+
+    if( node->localName == NULL ) { // end tags only carry the name
+        rc = Parser_setNodePrefixAndLocalName( node );
+        if( rc != IXML_SUCCESS ) {
+            return rc;
+        }
+    }
+
+    element->nodeName = node->nodeName;
+    element->prefix = node->prefix;
+    element->localName = node->localName;
+    element->namespaceURI = Parser_saxNamespace( xmlParser, node );
+    element->depth = depth;
+    element->offset = offset;
+
+    return IXML_SUCCESS;
+}
+
+/*================================================================
+*   Parser_SaxDocument
+*       Scans the buffer with the same tokenizer as the DOM builder,
+*       but reports elements and text to the handler instead of
+*       building a tree. A start tag is reported once all its
+*       attributes have been read, so xmlns declarations on the tag
+*       are already in scope.
+*       Internal to parser only.
+*
+*=================================================================*/
+int
+Parser_SaxDocument( IN const char *buffer,
+                    IN const IXML_SaxHandler * handler,
+                    IN void *cookie )
+{
+    Parser *xmlParser = NULL;
+    IXML_Node newNode;
+    IXML_Node startNode;        // start tag waiting for its attributes
+    IXML_SaxElement element;
+    BOOL bETag = FALSE;
+    BOOL bPending = FALSE;
+    size_t startOffset = 0;
+    int depth = 0;
+    int rc = IXML_SUCCESS;
+
+    ixmlNode_init( &newNode );
+    ixmlNode_init( &startNode );
+
+    xmlParser = Parser_init(  );
+    if( xmlParser == NULL ) {
+        return IXML_INSUFFICIENT_MEMORY;
+    }
+    // the tokenizer never writes to the buffer, so scan it in place
+    xmlParser->curPtr = ( char * )buffer;
+
+    rc = Parser_skipProlog( xmlParser );
+    if( rc != IXML_SUCCESS ) {
+        goto ErrorHandler;
+    }
+
+    while( bETag == FALSE ) {
+        ixmlNode_init( &newNode );
+
+        if( Parser_getNextNode( xmlParser, &newNode, &bETag ) !=
+            IXML_SUCCESS ) {
+            if( bETag == TRUE ) {   // file is done
+                break;
+            }
+            rc = IXML_FAILED;
+            goto ErrorHandler;
+        }
+
+        if( bETag == FALSE ) {
+            switch ( newNode.nodeType ) {
+                case eELEMENT_NODE:
+                    if( xmlParser->bHasTopLevel == TRUE && depth == 0 ) {
+                        rc = IXML_SYNTAX_ERR;
+                        goto ErrorHandler;
+                    }
+                    xmlParser->bHasTopLevel = TRUE;
+
+                    rc = Parser_pushElement( xmlParser, &newNode );
+                    if( rc != IXML_SUCCESS ) {
+                        goto ErrorHandler;
+                    }
+
+                    depth++;
+                    startOffset = xmlParser->tagStart - buffer;
+                    // keep the name around until the tag is complete
+                    startNode = newNode;
+                    ixmlNode_init( &newNode );
+                    bPending = TRUE;
+                    break;
+
+                case eTEXT_NODE:
+                case eCDATA_SECTION_NODE:
+                    if( handler->characters != NULL ) {
+                        rc = handler->characters( cookie,
+                                                  newNode.nodeValue,
+                                                  depth );
+                        if( rc != IXML_SUCCESS ) {
+                            goto ErrorHandler;
+                        }
+                    }
+                    break;
+
+                default:        // attributes only matter for xmlns
+                    break;
+            }
+        }
+
+        if( bPending && ( bETag || xmlParser->state != eATTRIBUTE ) ) {
+            bPending = FALSE;
+            if( handler->startElement != NULL ) {
+                rc = Parser_saxElement( xmlParser, &startNode, depth,
+                                        startOffset, &element );
+                if( rc == IXML_SUCCESS ) {
+                    rc = handler->startElement( cookie, &element );
+                }
+                if( rc != IXML_SUCCESS ) {
+                    goto ErrorHandler;
+                }
+            }
+            Parser_freeNodeContent( &startNode );
+            ixmlNode_init( &startNode );
+        }
+
+        if( bETag == TRUE ) {   // </name> or />
+            if( ( xmlParser->pCurElement == NULL ) ||
+                ( Parser_isValidEndElement( xmlParser, &newNode ) !=
+                  TRUE ) ) {
+                rc = IXML_SYNTAX_ERR;
+                goto ErrorHandler;
+            }
+
+            if( handler->endElement != NULL ) {
+                rc = Parser_saxElement( xmlParser, &newNode, depth,
+                                        xmlParser->curPtr - buffer,
+                                        &element );
+                if( rc == IXML_SUCCESS ) {
+                    rc = handler->endElement( cookie, &element );
+                }
+                if( rc != IXML_SUCCESS ) {
+                    goto ErrorHandler;
+                }
+            }
+
+            Parser_popElement( xmlParser );
+            depth--;
+            xmlParser->state = eCONTENT;
+            bETag = FALSE;
+        }
+
+        Parser_freeNodeContent( &newNode );
+    }
+
+    if( xmlParser->pCurElement != NULL || !xmlParser->bHasTopLevel ) {
+        rc = IXML_SYNTAX_ERR;
+    }
+
+  ErrorHandler:
+    Parser_freeNodeContent( &newNode );
+    Parser_freeNodeContent( &startNode );
+    Parser_free( xmlParser );
+    return rc;
+}
+
 /*==============================================================================*
 *   Parser_setLastElem
 *       set the last element to be the given string.
@@ -1075,7 +1316,11 @@ Parser_setLastElem( IN Parser * xmlParser,
 static void
 Parser_clearTokenBuf( IN Parser * xmlParser )
 {
-    ixml_membuf_destroy( &( xmlParser->tokenBuf ) );
+    // keep the storage, the next token is usually about as long
+    ( xmlParser->tokenBuf ).length = 0;
+    if( ( xmlParser->tokenBuf ).buf != NULL ) {
+        ( xmlParser->tokenBuf ).buf[0] = '\0';
+    }
 }
 
 /*==============================================================================*
@@ -1632,7 +1877,7 @@ Parser_addNamespace( IN Parser * xmlParser )
             // it would be wrong that pNode->namespace != NULL.
             assert( pNode->namespaceURI == NULL );
 
-            pNode->namespaceURI = safe_strdup( pCur->namespaceUri );
+            pNode->namespaceURI = ixmlNode_strdup( pNode, pCur->namespaceUri );
             if( pNode->namespaceURI == NULL ) {
                 return IXML_INSUFFICIENT_MEMORY;
             }
@@ -1648,7 +1893,7 @@ Parser_addNamespace( IN Parser * xmlParser )
 
         namespaceUri = Parser_getNameSpace( xmlParser, pCur->prefix );
         if( namespaceUri != NULL ) {
-            pNode->namespaceURI = safe_strdup( namespaceUri );
+            pNode->namespaceURI = ixmlNode_strdup( pNode, namespaceUri );
             if( pNode->namespaceURI == NULL ) {
                 return IXML_INSUFFICIENT_MEMORY;
             }
@@ -1683,7 +1928,7 @@ Parser_setNodePrefixAndLocalName( IN IXML_Node * node )
     pStrPrefix = strchr( node->nodeName, ':' );
     if( pStrPrefix == NULL ) {
         node->prefix = NULL;
-        node->localName = safe_strdup( node->nodeName );
+        node->localName = ixmlNode_strdup( node, node->nodeName );
         if( node->localName == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -1692,7 +1937,8 @@ Parser_setNodePrefixAndLocalName( IN IXML_Node * node )
 
         pLocalName = ( char * )pStrPrefix + 1;
         nPrefix = pStrPrefix - node->nodeName;
-        node->prefix = os_alloc( nPrefix + 1 );
+        node->prefix = ixmlDocument_allocMem( node->ownerDocument,
+                                              nPrefix + 1 );
         if( node->prefix == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -1700,9 +1946,9 @@ Parser_setNodePrefixAndLocalName( IN IXML_Node * node )
         memset( node->prefix, 0, nPrefix + 1 );
         strncpy( node->prefix, node->nodeName, nPrefix );
 
-        node->localName = safe_strdup( pLocalName );
+        node->localName = ixmlNode_strdup( node, pLocalName );
         if( node->localName == NULL ) {
-            os_free( node->prefix );
+            ixmlNode_freeMem( node, node->prefix );
             node->prefix = NULL;    //no need to free really, main loop will frees it
             //when return code is not success
             return IXML_INSUFFICIENT_MEMORY;
@@ -2030,7 +2276,8 @@ Parser_setElementNamespace( IN IXML_Element * newElement,
         if( newElement->n.namespaceURI != NULL ) {
             return IXML_SYNTAX_ERR;
         } else {
-            ( newElement->n ).namespaceURI = safe_strdup( nsURI );
+            ( newElement->n ).namespaceURI =
+                ixmlNode_strdup( &newElement->n, nsURI );
             if( ( newElement->n ).namespaceURI == NULL ) {
                 return IXML_INSUFFICIENT_MEMORY;
             }
@@ -2458,6 +2705,7 @@ Parser_getNextNode( IN Parser * xmlParser,
         }
     } else {
         Parser_skipWhiteSpaces( xmlParser );
+        xmlParser->tagStart = xmlParser->curPtr;
         if( ( Parser_getNextToken( xmlParser ) == 0 ) && ( xmlParser->pCurElement == NULL ) && ( *( xmlParser->curPtr ) == '\0' ) ) {   // comments after the xml doc
             return IXML_SUCCESS;
         } else if( ( xmlParser->tokenBuf ).length == 0 ) {
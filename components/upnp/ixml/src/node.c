@@ -71,6 +71,51 @@ ixmlCDATASection_free( IN IXML_CDATASection * nodeptr )
     }
 }
 
+/*================================================================
+*   ixmlNode_strdup
+*       Duplicates a string for a field of nodeptr, in the arena of
+*       its owner document if it has one. NULL is duplicated as "".
+*       Internal to parser only.
+*
+*=================================================================*/
+char *
+ixmlNode_strdup( IN IXML_Node * nodeptr,
+                 IN const char *s )
+{
+    IXML_Document *doc = nodeptr->ownerDocument;
+
+    if( ( doc != NULL ) && ( doc->arena != NULL ) ) {
+        return ixmlArena_strdup( doc->arena, s );
+    }
+
+    return strdup( s != NULL ? s : "" );
+}
+
+/*================================================================
+*   ixmlNode_freeMem
+*       Frees memory held by nodeptr (a field or the node itself).
+*       Memory carved from the owner document's arena is left
+*       alone; it goes away with the document.
+*       Internal to parser only.
+*
+*=================================================================*/
+void
+ixmlNode_freeMem( IN IXML_Node * nodeptr,
+                  IN void *p )
+{
+    IXML_Document *doc = nodeptr->ownerDocument;
+
+    if( p == NULL ) {
+        return;
+    }
+
+    if( ( doc != NULL ) && ixmlArena_owns( doc->arena, p ) ) {
+        return;
+    }
+
+    os_free( p );
+}
+
 /*================================================================
 *   ixmlNode_freeSingleNode
 *       frees a node content.
@@ -81,34 +126,28 @@ void
 ixmlNode_freeSingleNode( IN IXML_Node * nodeptr )
 {
     IXML_Element *element = NULL;
+    IXML_Document *doc = NULL;
 
     if( nodeptr != NULL ) {
-        if( nodeptr->nodeName != NULL ) {
-            os_free( nodeptr->nodeName );
-        }
-
-        if( nodeptr->nodeValue != NULL ) {
-            os_free( nodeptr->nodeValue );
-        }
-
-        if( nodeptr->namespaceURI != NULL ) {
-            os_free( nodeptr->namespaceURI );
-        }
-
-        if( nodeptr->prefix != NULL ) {
-            os_free( nodeptr->prefix );
-        }
-
-        if( nodeptr->localName != NULL ) {
-            os_free( nodeptr->localName );
-        }
+        ixmlNode_freeMem( nodeptr, nodeptr->nodeName );
+        ixmlNode_freeMem( nodeptr, nodeptr->nodeValue );
+        ixmlNode_freeMem( nodeptr, nodeptr->namespaceURI );
+        ixmlNode_freeMem( nodeptr, nodeptr->prefix );
+        ixmlNode_freeMem( nodeptr, nodeptr->localName );
 
         if( nodeptr->nodeType == eELEMENT_NODE ) {
             element = ( IXML_Element * ) nodeptr;
-            os_free( element->tagName );
+            ixmlNode_freeMem( nodeptr, element->tagName );
+        }
+
+        if( nodeptr->nodeType == eDOCUMENT_NODE ) {
+            // the document itself is on the heap; its nodes are gone by now
+            doc = ( IXML_Document * ) nodeptr;
+            ixmlArena_free( doc->arena );
+            doc->arena = NULL;
         }
 
-        os_free( nodeptr );
+        ixmlNode_freeMem( nodeptr, nodeptr );
 
     }
 }
@@ -183,12 +222,12 @@ ixmlNode_setNamespaceURI( IN IXML_Node * nodeptr,
     }
 
     if( nodeptr->namespaceURI != NULL ) {
-        os_free( nodeptr->namespaceURI );
+        ixmlNode_freeMem( nodeptr, nodeptr->namespaceURI );
         nodeptr->namespaceURI = NULL;
     }
 
     if( namespaceURI != NULL ) {
-        nodeptr->namespaceURI = strdup( namespaceURI );
+        nodeptr->namespaceURI = ixmlNode_strdup( nodeptr, namespaceURI );
         if( nodeptr->namespaceURI == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -215,12 +254,12 @@ ixmlNode_setPrefix( IN IXML_Node * nodeptr,
     }
 
     if( nodeptr->prefix != NULL ) {
-        os_free( nodeptr->prefix );
+        ixmlNode_freeMem( nodeptr, nodeptr->prefix );
         nodeptr->prefix = NULL;
     }
 
     if( prefix != NULL ) {
-        nodeptr->prefix = strdup( prefix );
+        nodeptr->prefix = ixmlNode_strdup( nodeptr, prefix );
         if( nodeptr->prefix == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -246,12 +285,12 @@ ixmlNode_setLocalName( IN IXML_Node * nodeptr,
     assert( nodeptr != NULL );
 
     if( nodeptr->localName != NULL ) {
-        os_free( nodeptr->localName );
+        ixmlNode_freeMem( nodeptr, nodeptr->localName );
         nodeptr->localName = NULL;
     }
 
     if( localName != NULL ) {
-        nodeptr->localName = strdup( localName );
+        nodeptr->localName = ixmlNode_strdup( nodeptr, localName );
         if( nodeptr->localName == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -339,12 +378,12 @@ ixmlNode_setNodeValue( IN IXML_Node * nodeptr,
     }
 
     if( nodeptr->nodeValue != NULL ) {
-        os_free( nodeptr->nodeValue );
+        ixmlNode_freeMem( nodeptr, nodeptr->nodeValue );
         nodeptr->nodeValue = NULL;
     }
 
     if( newNodeValue != NULL ) {
-        nodeptr->nodeValue = strdup( newNodeValue );
+        nodeptr->nodeValue = ixmlNode_strdup( nodeptr, newNodeValue );
         if( nodeptr->nodeValue == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
@@ -1567,20 +1606,20 @@ ixmlNode_setNodeName( IN IXML_Node * node,
     assert( node != NULL );
 
     if( node->nodeName != NULL ) {
-        os_free( node->nodeName );
+        ixmlNode_freeMem( node, node->nodeName );
         node->nodeName = NULL;
     }
 
     if( qualifiedName != NULL ) {
         // set the name part
-        node->nodeName = strdup( qualifiedName );
+        node->nodeName = ixmlNode_strdup( node, qualifiedName );
         if( node->nodeName == NULL ) {
             return IXML_INSUFFICIENT_MEMORY;
         }
 
         rc = Parser_setNodePrefixAndLocalName( node );
         if( rc != IXML_SUCCESS ) {
-            os_free( node->nodeName );
+            ixmlNode_freeMem( node, node->nodeName );
         }
     }
 
@@ -1622,15 +1661,15 @@ ixmlNode_setNodeProperties( IN IXML_Node * destNode,
 
   ErrorHandler:
     if( destNode->nodeName != NULL ) {
-        os_free( destNode->nodeName );
+        ixmlNode_freeMem( destNode, destNode->nodeName );
         destNode->nodeName = NULL;
     }
     if( destNode->nodeValue != NULL ) {
-        os_free( destNode->nodeValue );
+        ixmlNode_freeMem( destNode, destNode->nodeValue );
         destNode->nodeValue = NULL;
     }
     if( destNode->localName != NULL ) {
-        os_free( destNode->localName );
+        ixmlNode_freeMem( destNode, destNode->localName );
         destNode->localName = NULL;
     }
 
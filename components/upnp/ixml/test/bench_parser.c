@@ -0,0 +1,170 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// Parser benchmark: heap DOM vs arena DOM vs streaming scan.
+//
+// Build on the host (glibc) against the ixml sources; the allocator
+// calls are counted by interposing malloc and friends:
+//
+//   cc -O2 -Dos_alloc=malloc -Dos_free=free -Dos_realloc=realloc \
+//      -Iinc -Isrc/inc src/*.c test/bench_parser.c -o bench_parser
+//   ./bench_parser test/testdata/tvcontrolSCPD.xml \
+//      test/testdata/soap_action.xml
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include "ixml.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ROUNDS 2000
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_realloc (void *p, size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void __libc_free (void *p);
+
+static unsigned long n_alloc;
+static size_t peak, cur, base;
+
+static void
+account (void *p)
+{
+	if (p == NULL)
+		return;
+	n_alloc++;
+	cur += malloc_usable_size (p);
+	if (cur > peak)
+		peak = cur;
+}
+
+void *
+malloc (size_t size)
+{
+	void *p = __libc_malloc (size);
+
+	account (p);
+	return p;
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+	void *p = __libc_calloc (n, size);
+
+	account (p);
+	return p;
+}
+
+void
+free (void *p)
+{
+	if (p != NULL)
+		cur -= malloc_usable_size (p);
+	__libc_free (p);
+}
+
+void *
+realloc (void *p, size_t size)
+{
+	if (p != NULL)
+		cur -= malloc_usable_size (p);
+	p = __libc_realloc (p, size);
+	account (p);
+	return p;
+}
+
+static char *
+load_file (const char *name)
+{
+	FILE *f = fopen (name, "rb");
+	char *buf;
+	long len;
+
+	if (f == NULL)
+		return NULL;
+	fseek (f, 0, SEEK_END);
+	len = ftell (f);
+	fseek (f, 0, SEEK_SET);
+	buf = malloc (len + 1);
+	if (buf != NULL)
+		buf[fread (buf, 1, len, f)] = '\0';
+	fclose (f);
+	return buf;
+}
+
+static int
+count_element (void *cookie, const IXML_SaxElement *element)
+{
+	(*(int *) cookie)++;
+	return IXML_SUCCESS;
+}
+
+static void
+report (const char *what, clock_t t)
+{
+	printf ("    %-10s %8.2f us/parse %6lu allocs/parse %7lu peak bytes\n",
+		what, (double) t * 1e6 / CLOCKS_PER_SEC / ROUNDS,
+		n_alloc / ROUNDS, (unsigned long) (peak - base));
+	n_alloc = 0;
+	peak = base = cur;
+}
+
+int
+main (int argc, char* argv[])
+{
+	IXML_SaxHandler handler = { count_element, NULL, NULL };
+	int i, r;
+
+	if (argc < 2) {
+		fprintf (stderr, "Usage: %s [xml files to parse]\n", argv[0]);
+		exit (EXIT_FAILURE); // ---------->
+	}
+
+	for (i = 1; i < argc; i++) {
+		char *buf = load_file (argv[i]);
+		IXML_Document *doc;
+		int elements = 0;
+		clock_t t;
+
+		if (buf == NULL) {
+			fprintf (stderr, "** error : can't read %s\n", argv[i]);
+			exit (EXIT_FAILURE); // ---------->
+		}
+		printf ("%s (%u bytes)\n", argv[i], (unsigned) strlen (buf));
+		n_alloc = 0;
+		peak = base = cur;
+
+		ixmlArenaParser (FALSE);
+		t = clock ();
+		for (r = 0; r < ROUNDS; r++) {
+			if (ixmlParseBufferEx (buf, &doc) != IXML_SUCCESS)
+				exit (EXIT_FAILURE); // ---------->
+			ixmlDocument_free (doc);
+		}
+		report ("heap DOM", clock () - t);
+
+		ixmlArenaParser (TRUE);
+		t = clock ();
+		for (r = 0; r < ROUNDS; r++) {
+			if (ixmlParseBufferEx (buf, &doc) != IXML_SUCCESS)
+				exit (EXIT_FAILURE); // ---------->
+			ixmlDocument_free (doc);
+		}
+		report ("arena DOM", clock () - t);
+
+		t = clock ();
+		for (r = 0; r < ROUNDS; r++) {
+			if (ixmlParseBufferSax (buf, &handler, &elements) !=
+			    IXML_SUCCESS)
+				exit (EXIT_FAILURE); // ---------->
+		}
+		report ("stream", clock () - t);
+
+		free (buf);
+	}
+
+	exit (EXIT_SUCCESS);
+}
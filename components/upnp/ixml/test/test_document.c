@@ -65,6 +65,7 @@ get_ixml_error_string (IXML_ERRORCODE code)
 		CASE(INVALID_PARAMETER);
 		CASE(FAILED);
 		CASE(INVALID_ITEM_NUMBER);
+		CASE(SAX_STOPPED);
 	}
 	return "** UNKNOWN EROR CODE !! **";
 
@@ -61,6 +61,11 @@ typedef enum priority {LOW_PRIORITY,
 		       MED_PRIORITY,
 		       HIGH_PRIORITY} ThreadPriority;
 
+#define NUM_PRIORITIES (HIGH_PRIORITY + 1)
+
+typedef enum tpmode {TP_MODE_SHARED_QUEUE,
+		     TP_MODE_WORK_STEALING} ThreadPoolMode;
+
 #define DEFAULT_PRIORITY MED_PRIORITY /* default priority used by TPJobInit */
 #define DEFAULT_MIN_THREADS 1	      /* default minimum used by TPAttrInit */
 #define DEFAULT_MAX_THREADS 10	      /* default max used by TPAttrInit	*/
@@ -69,6 +74,7 @@ typedef enum priority {LOW_PRIORITY,
 #define DEFAULT_IDLE_TIME 10 * 1000   /* default idle time used by TPAttrInit */
 #define DEFAULT_FREE_ROUTINE NULL     /* default free routine used TPJobInit */
 #define DEFAULT_MAX_JOBS_TOTAL 100    /* default max jobs used TPAttrInit */
+#define DEFAULT_POOL_MODE TP_MODE_SHARED_QUEUE /* default mode used by TPAttrInit */
 
 /* Statistics */
 /* always include stats because code change is minimal */
@@ -131,6 +137,10 @@ typedef struct THREADPOOLATTR
 
 	/* scheduling policy to use */
 	PolicyType schedPolicy;
+
+	/* how jobs are handed to workers, see ThreadPool. Only read by
+	 * ThreadPoolInit, the mode of a running pool can not be changed */
+	ThreadPoolMode mode;
 } ThreadPoolAttr;
 
 /****************************************************************************
@@ -147,8 +157,36 @@ typedef struct THREADPOOLJOB
 	struct timeval requestTime;
 	int priority;
 	int jobId;
+	struct THREADPOOLJOB *next; /* link in the work stealing queues */
 } ThreadPoolJob;
 
+struct THREADPOOL;
+
+/****************************************************************************
+ * Name: TPWorker
+ *
+ *  Description:
+ *     Internal state of one worker of a TP_MODE_WORK_STEALING pool.
+ *     The run queues are filled only by the worker itself, from the
+ *     submission stacks of the pool, and are emptied from the head by
+ *     the worker and by idle workers stealing from it.
+ *****************************************************************************/
+typedef struct TPWORKER
+{
+	struct THREADPOOL *tp;
+	struct os_semaphore wakeup; /* posted to wake this worker only */
+	ithread_mutex_t lock;       /* protects head and tail */
+	ThreadPoolJob *head[NUM_PRIORITIES]; /* run queue per priority */
+	ThreadPoolJob *tail[NUM_PRIORITIES];
+	int running;                /* slot has a thread */
+	struct TPWORKER *nextIdle;  /* link in the idle stack */
+
+	/* statistics, only written by the worker itself */
+	unsigned long jobs[NUM_PRIORITIES];
+	unsigned long waitTime[NUM_PRIORITIES];
+	unsigned long stolen;
+} TPWorker;
+
 /****************************************************************************
  * Name: ThreadPoolStats
  *
@@ -177,6 +215,7 @@ typedef struct TPOOLSTATS
 	int currentJobsHQ;
 	int currentJobsLQ;
 	int currentJobsMQ;
+	int totalJobsStolen; /* TP_MODE_WORK_STEALING only */
 } ThreadPoolStats;
 
 
@@ -198,6 +237,13 @@ typedef struct TPOOLSTATS
  *     less than the maximum threads then a new thread will
  *     be created.
  *
+ *     In TP_MODE_SHARED_QUEUE all jobs go through three lists guarded
+ *     by the pool mutex. In TP_MODE_WORK_STEALING ThreadPoolAdd pushes
+ *     jobs on a lock-free stack per priority and wakes a single idle
+ *     worker; workers move whole stacks into their own run queues and
+ *     idle workers steal from the run queues of busy ones, so the pool
+ *     mutex is only taken to start and stop threads.
+ *
  *****************************************************************************/
 
 typedef struct THREADPOOL
@@ -218,6 +264,15 @@ typedef struct THREADPOOL
 
 	ThreadPoolAttr attr; /* thread pool attributes */
 
+	/* TP_MODE_WORK_STEALING only */
+	ThreadPoolJob *inbox[NUM_PRIORITIES]; /* lock-free stacks of new jobs */
+	int queuedJobs[NUM_PRIORITIES];  /* jobs not yet started, atomic */
+	TPWorker *workers;     /* attr.maxThreads worker slots */
+	int numWorkers;
+	TPWorker *idleWorkers; /* workers waiting on their wakeup */
+	int idleCount;         /* length of idleWorkers, atomic */
+	ithread_mutex_t idleLock; /* protects idleWorkers */
+
 	/* statistics */
 	ThreadPoolStats stats;
 } ThreadPool;
@@ -514,6 +569,19 @@ int TPAttrSetSchedPolicy(ThreadPoolAttr *attr, PolicyType schedPolicy);
  *****************************************************************************/
 int TPAttrSetMaxJobsTotal(ThreadPoolAttr *attr, int maxJobsTotal);
 
+/****************************************************************************
+ * Function: TPAttrSetMode
+ *
+ *  Description:
+ *      Selects the shared queue or the work stealing scheduler.
+ *  Parameters:
+ *      attr - must be valid thread pool attributes.
+ *      mode - TP_MODE_SHARED_QUEUE or TP_MODE_WORK_STEALING
+ *  Returns:
+ *      Always returns 0.
+ *****************************************************************************/
+int TPAttrSetMode(ThreadPoolAttr *attr, ThreadPoolMode mode);
+
 /****************************************************************************
  * Function: ThreadPoolGetStats
  *
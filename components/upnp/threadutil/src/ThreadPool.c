@@ -33,6 +33,7 @@
 #include "FreeList.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <stdio.h>
 
@@ -97,6 +98,7 @@ static void StatsInit( ThreadPoolStats *stats )
 	stats->idleThreads = 0;
 	stats->persistentThreads = 0;
 	stats->maxThreads = 0; stats->totalThreads = 0;
+	stats->totalJobsStolen = 0;
 }
 
 static void StatsAccountLQ( ThreadPool *tp, unsigned long diffTime )
@@ -585,6 +587,901 @@ static void *WorkerThread( void *arg )
 	}
 }
 
+/*
+ * Work stealing mode (TP_MODE_WORK_STEALING).
+ *
+ * ThreadPoolAdd pushes jobs on a lock-free stack per priority and posts
+ * the semaphore of one idle worker. A worker takes a whole stack at once
+ * into its own run queue, oldest job first, and an idle worker steals
+ * from the head of the run queue of a busy one. Each run queue has its
+ * own lock and no thread ever holds two of them, so submitters never
+ * wait on a worker and workers only meet when stealing.
+ * tp->mutex is kept for starting and stopping threads and for the
+ * persistent job handoff.
+ */
+#define TP_LOAD( p )		__atomic_load_n( ( p ), __ATOMIC_SEQ_CST )
+#define TP_STORE( p, v )	__atomic_store_n( ( p ), ( v ), __ATOMIC_SEQ_CST )
+#define TP_ADD( p, v )		__atomic_add_fetch( ( p ), ( v ), __ATOMIC_SEQ_CST )
+
+/****************************************************************************
+ * Function: QueuedJobs
+ *
+ *  Description:
+ *      Returns the number of jobs of all priorities that have been
+ *      added and not yet started.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *****************************************************************************/
+static int QueuedJobs( ThreadPool *tp )
+{
+	int jobs = 0;
+	int i;
+
+	for( i = 0; i < NUM_PRIORITIES; i++ ) {
+		jobs += TP_LOAD( &tp->queuedJobs[i] );
+	}
+
+	return jobs;
+}
+
+/****************************************************************************
+ * Function: InboxPush
+ *
+ *  Description:
+ *      Pushes a job on the submission stack of its priority.
+ *      Lock-free, may be called from any thread.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *      ThreadPoolJob *job
+ *****************************************************************************/
+static void InboxPush( ThreadPool *tp, ThreadPoolJob *job )
+{
+	ThreadPoolJob **top = &tp->inbox[job->priority];
+
+	job->next = __atomic_load_n( top, __ATOMIC_RELAXED );
+	while( !__atomic_compare_exchange_n( top, &job->next, job, 1,
+	                                     __ATOMIC_RELEASE, __ATOMIC_RELAXED ) ) {
+	}
+}
+
+/****************************************************************************
+ * Function: InboxTake
+ *
+ *  Description:
+ *      Takes every job pushed so far on the submission stack of one
+ *      priority. The stack is swapped out whole, so there is no ABA
+ *      problem with a concurrent push.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *      int prio
+ *  Returns:
+ *      the jobs linked oldest first, NULL if there were none.
+ *****************************************************************************/
+static ThreadPoolJob *InboxTake( ThreadPool *tp, int prio )
+{
+	ThreadPoolJob *job = NULL;
+	ThreadPoolJob *next = NULL;
+	ThreadPoolJob *fifo = NULL;
+
+	if( __atomic_load_n( &tp->inbox[prio], __ATOMIC_RELAXED ) == NULL ) {
+		return NULL;
+	}
+
+	job = __atomic_exchange_n( &tp->inbox[prio], NULL, __ATOMIC_ACQUIRE );
+	while( job != NULL ) {
+		next = job->next;
+		job->next = fifo;
+		fifo = job;
+		job = next;
+	}
+
+	return fifo;
+}
+
+/****************************************************************************
+ * Function: RunQAppend
+ *
+ *  Description:
+ *      Appends a chain of jobs to a run queue of a worker.
+ *      w->lock must be locked.
+ *      Internal Only.
+ *  Parameters:
+ *      TPWorker *w
+ *      int prio
+ *      ThreadPoolJob *first - chain linked through next
+ *****************************************************************************/
+static void RunQAppend( TPWorker *w, int prio, ThreadPoolJob *first )
+{
+	ThreadPoolJob *last = first;
+
+	while( last->next != NULL ) {
+		last = last->next;
+	}
+
+	if( w->tail[prio] != NULL ) {
+		w->tail[prio]->next = first;
+	} else {
+		/* peeked at without the lock by stealing workers */
+		__atomic_store_n( &w->head[prio], first, __ATOMIC_RELAXED );
+	}
+	w->tail[prio] = last;
+}
+
+/****************************************************************************
+ * Function: RunQPop
+ *
+ *  Description:
+ *      Removes the oldest job from a run queue of a worker and takes
+ *      it off the count of queued jobs.
+ *      w->lock must be locked.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *      TPWorker *w
+ *      int prio
+ *  Returns:
+ *      the job, NULL if the queue is empty.
+ *****************************************************************************/
+static ThreadPoolJob *RunQPop( ThreadPool *tp, TPWorker *w, int prio )
+{
+	ThreadPoolJob *job = w->head[prio];
+
+	if( job != NULL ) {
+		__atomic_store_n( &w->head[prio], job->next, __ATOMIC_RELAXED );
+		if( job->next == NULL ) {
+			w->tail[prio] = NULL;
+		}
+		job->next = NULL;
+		TP_ADD( &tp->queuedJobs[prio], -1 );
+	}
+
+	return job;
+}
+
+/****************************************************************************
+ * Function: TakeOwnJob
+ *
+ *  Description:
+ *      Takes the oldest job of one priority from the run queue of
+ *      the worker, refilling the queue from the submission stack
+ *      when it is empty.
+ *      If now is not NULL only a job that has waited at least the
+ *      starvation time is taken.
+ *      Internal Only.
+ *  Parameters:
+ *      TPWorker *self
+ *      int prio
+ *      struct timeval *now
+ *      int *more - set if jobs are left in the run queue
+ *  Returns:
+ *      the job, NULL if there is none.
+ *****************************************************************************/
+static ThreadPoolJob *TakeOwnJob( TPWorker *self, int prio,
+	struct timeval *now, int *more )
+{
+	ThreadPool *tp = self->tp;
+	ThreadPoolJob *job = NULL;
+	ThreadPoolJob *batch = NULL;
+
+	ithread_mutex_lock( &self->lock );
+
+	if( self->head[prio] == NULL ) {
+		batch = InboxTake( tp, prio );
+		if( batch != NULL ) {
+			RunQAppend( self, prio, batch );
+		}
+	}
+
+	if( self->head[prio] != NULL &&
+	    ( now == NULL ||
+	      DiffMillis( now, &self->head[prio]->requestTime ) >=
+	      ( unsigned long )tp->attr.starvationTime ) ) {
+		job = RunQPop( tp, self, prio );
+	}
+	*more = ( self->head[prio] != NULL );
+
+	ithread_mutex_unlock( &self->lock );
+
+	return job;
+}
+
+/****************************************************************************
+ * Function: StealJob
+ *
+ *  Description:
+ *      Takes the oldest job of one priority from the run queue of
+ *      another worker, starting with the next worker slot so that
+ *      thieves spread over their victims.
+ *      Internal Only.
+ *  Parameters:
+ *      TPWorker *self
+ *      int prio
+ *      int *more - set if jobs are left in the victim's run queue
+ *  Returns:
+ *      the job, NULL if no worker had one.
+ *****************************************************************************/
+static ThreadPoolJob *StealJob( TPWorker *self, int prio, int *more )
+{
+	ThreadPool *tp = self->tp;
+	ThreadPoolJob *job = NULL;
+	TPWorker *victim = NULL;
+	int n = tp->numWorkers;
+	int i;
+
+	for( i = 1; i < n && job == NULL; i++ ) {
+		victim = &tp->workers[( self - tp->workers + i ) % n];
+		if( __atomic_load_n( &victim->head[prio], __ATOMIC_RELAXED ) == NULL ) {
+			continue;
+		}
+		ithread_mutex_lock( &victim->lock );
+		job = RunQPop( tp, victim, prio );
+		*more = ( victim->head[prio] != NULL );
+		ithread_mutex_unlock( &victim->lock );
+	}
+
+	return job;
+}
+
+/****************************************************************************
+ * Function: WakeIdleWorker
+ *
+ *  Description:
+ *      Wakes the worker that went idle last, if any.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *  Returns:
+ *      1 if a worker was woken, 0 if none was idle.
+ *****************************************************************************/
+static int WakeIdleWorker( ThreadPool *tp )
+{
+	TPWorker *w = NULL;
+
+	if( TP_LOAD( &tp->idleCount ) == 0 ) {
+		return 0;
+	}
+
+	ithread_mutex_lock( &tp->idleLock );
+	w = tp->idleWorkers;
+	if( w != NULL ) {
+		tp->idleWorkers = w->nextIdle;
+		w->nextIdle = NULL;
+		TP_ADD( &tp->idleCount, -1 );
+	}
+	ithread_mutex_unlock( &tp->idleLock );
+
+	if( w == NULL ) {
+		return 0;
+	}
+
+	os_sem_post( &w->wakeup );
+
+	return 1;
+}
+
+/****************************************************************************
+ * Function: IdleRemove
+ *
+ *  Description:
+ *      Takes a worker off the idle stack.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *      TPWorker *self
+ *  Returns:
+ *      1 if it was still there, 0 if a waker already took it off
+ *      and has posted or is about to post its semaphore.
+ *****************************************************************************/
+static int IdleRemove( ThreadPool *tp, TPWorker *self )
+{
+	TPWorker **link = NULL;
+	int found = 0;
+
+	ithread_mutex_lock( &tp->idleLock );
+	for( link = &tp->idleWorkers; *link != NULL; link = &( *link )->nextIdle ) {
+		if( *link == self ) {
+			*link = self->nextIdle;
+			self->nextIdle = NULL;
+			TP_ADD( &tp->idleCount, -1 );
+			found = 1;
+			break;
+		}
+	}
+	ithread_mutex_unlock( &tp->idleLock );
+
+	return found;
+}
+
+/****************************************************************************
+ * Function: NextJob
+ *
+ *  Description:
+ *      Finds the next job for a worker: a starved med or low priority
+ *      job of its own first, then by priority its own run queue, the
+ *      submission stack and the run queues of the other workers.
+ *      Wakes another idle worker when jobs are left behind, so that
+ *      a batch taken from a submission stack is spread out.
+ *      Internal Only.
+ *  Parameters:
+ *      TPWorker *self
+ *  Returns:
+ *      the job, NULL if there is nothing to do.
+ *****************************************************************************/
+static ThreadPoolJob *NextJob( TPWorker *self )
+{
+	ThreadPool *tp = self->tp;
+	ThreadPoolJob *job = NULL;
+	struct timeval now;
+	int more = 0;
+	int prio;
+
+	if( tp->attr.starvationTime > 0 &&
+	    ( TP_LOAD( &tp->queuedJobs[MED_PRIORITY] ) > 0 ||
+	      TP_LOAD( &tp->queuedJobs[LOW_PRIORITY] ) > 0 ) ) {
+		gettimeofday( &now, NULL );
+		for( prio = MED_PRIORITY; prio >= LOW_PRIORITY && job == NULL; prio-- ) {
+			job = TakeOwnJob( self, prio, &now, &more );
+		}
+	}
+
+	for( prio = HIGH_PRIORITY; prio >= LOW_PRIORITY && job == NULL; prio-- ) {
+		if( TP_LOAD( &tp->queuedJobs[prio] ) <= 0 ) {
+			continue;
+		}
+		job = TakeOwnJob( self, prio, NULL, &more );
+		if( job == NULL ) {
+			job = StealJob( self, prio, &more );
+#ifdef STATS
+			if( job != NULL ) {
+				self->stolen++;
+			}
+#endif
+		}
+	}
+
+	if( job != NULL && more ) {
+		WakeIdleWorker( tp );
+	}
+
+	return job;
+}
+
+/****************************************************************************
+ * Function: ReleaseWorker
+ *
+ *  Description:
+ *      Gives the slot of an exiting worker back.
+ *      tp->mutex must be locked.
+ *      Internal Only.
+ *  Parameters:
+ *      TPWorker *self
+ *****************************************************************************/
+static void ReleaseWorker( TPWorker *self )
+{
+	ThreadPool *tp = self->tp;
+
+	self->running = 0;
+	tp->totalThreads--;
+	ithread_cond_broadcast( &tp->start_and_shutdown );
+}
+
+/****************************************************************************
+ * Function: WaitForJob
+ *
+ *  Description:
+ *      Puts the worker on the idle stack and sleeps on its own
+ *      semaphore until a job is added or the idle time runs out.
+ *      A wakeup may find nothing to do, the caller just looks again.
+ *      Internal Only.
+ *  Parameters:
+ *      TPWorker *self
+ *  Returns:
+ *      0 to look for work again, 1 if the worker has been released
+ *      because it stayed idle and the pool has more than min threads.
+ *****************************************************************************/
+static int WaitForJob( TPWorker *self )
+{
+	ThreadPool *tp = self->tp;
+
+	ithread_mutex_lock( &tp->idleLock );
+	self->nextIdle = tp->idleWorkers;
+	tp->idleWorkers = self;
+	TP_ADD( &tp->idleCount, 1 );
+	ithread_mutex_unlock( &tp->idleLock );
+
+	// Anything added before we were on the idle stack was not
+	// signalled to us, so look once more before sleeping.
+	if( QueuedJobs( tp ) > 0 ||
+	    TP_LOAD( &tp->persistentJob ) != NULL ||
+	    TP_LOAD( &tp->shutdown ) ) {
+		if( IdleRemove( tp, self ) ) {
+			return 0;
+		}
+	}
+
+	if( os_sem_wait_timeout( &self->wakeup,
+	                         SYSTIME_MS( tp->attr.maxIdleTime ) ) == 0 ) {
+		return 0;
+	}
+
+	// timed out, unless a waker took us off the stack meanwhile
+	if( !IdleRemove( tp, self ) ) {
+		return 0;
+	}
+
+	ithread_mutex_lock( &tp->mutex );
+	if( tp->totalThreads > tp->attr.minThreads ) {
+		ReleaseWorker( self );
+		ithread_mutex_unlock( &tp->mutex );
+		return 1;
+	}
+	ithread_mutex_unlock( &tp->mutex );
+
+	return 0;
+}
+
+/****************************************************************************
+ * Function: RunPersistentJob
+ *
+ *  Description:
+ *      Picks up the pending persistent job, if still there, and runs it.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *  Returns:
+ *      1 if a job was run, 0 otherwise.
+ *****************************************************************************/
+static int RunPersistentJob( ThreadPool *tp )
+{
+	ThreadPoolJob *job = NULL;
+
+	ithread_mutex_lock( &tp->mutex );
+	job = tp->persistentJob;
+	if( job != NULL ) {
+		TP_STORE( &tp->persistentJob, NULL );
+		tp->persistentThreads++;
+		ithread_cond_broadcast( &tp->start_and_shutdown );
+	}
+	ithread_mutex_unlock( &tp->mutex );
+
+	if( job == NULL ) {
+		return 0;
+	}
+
+	SetPriority( job->priority );
+	job->func( job->arg );
+	SetPriority( DEFAULT_PRIORITY );
+
+	ithread_mutex_lock( &tp->mutex );
+	tp->persistentThreads--;
+	ithread_mutex_unlock( &tp->mutex );
+
+	os_free( job );
+
+	return 1;
+}
+
+/****************************************************************************
+ * Function: StealingWorkerThread
+ *
+ *  Description:
+ *      Implements a worker of a TP_MODE_WORK_STEALING pool.
+ *      Worker picks up persistent jobs first, then jobs found by
+ *      NextJob, and sleeps on its own semaphore when there are none.
+ *      Internal Only.
+ *  Parameters:
+ *      void * arg -> is cast to TPWorker *
+ *****************************************************************************/
+static void *StealingWorkerThread( void *arg )
+{
+	TPWorker *self = ( TPWorker * )arg;
+	ThreadPool *tp = self->tp;
+	ThreadPoolJob *job = NULL;
+#ifdef STATS
+	struct timeval now;
+#endif
+
+	SetSeed();
+	while( !TP_LOAD( &tp->shutdown ) ) {
+		if( TP_LOAD( &tp->persistentJob ) != NULL && RunPersistentJob( tp ) ) {
+			continue;
+		}
+
+		job = NextJob( self );
+		if( job == NULL ) {
+			if( WaitForJob( self ) ) {
+				return NULL;
+			}
+			continue;
+		}
+
+#ifdef STATS
+		gettimeofday( &now, NULL );
+		self->jobs[job->priority]++;
+		self->waitTime[job->priority] += DiffMillis( &now, &job->requestTime );
+#endif
+		SetPriority( job->priority );
+		job->func( job->arg );
+		SetPriority( DEFAULT_PRIORITY );
+
+		os_free( job );
+	}
+
+	ithread_mutex_lock( &tp->mutex );
+	ReleaseWorker( self );
+	ithread_mutex_unlock( &tp->mutex );
+
+	return NULL;
+}
+
+/****************************************************************************
+ * Function: CreateStealingWorker
+ *
+ *  Description:
+ *      Starts a worker thread in a free worker slot.
+ *      Does not wait for the thread to run, the slot is counted in
+ *      totalThreads right away.
+ *      tp->mutex must be locked.
+ *      Internal to thread pool.
+ *  Parameters:
+ *      ThreadPool *tp
+ *
+ *  Returns:
+ *      0 on success, <0 on failure
+ *      EMAXTHREADS if all slots are in use
+ *      EAGAIN if system can not create thread
+ *****************************************************************************/
+static int CreateStealingWorker( ThreadPool *tp )
+{
+	TPWorker *w = NULL;
+	int i;
+
+	if( tp->totalThreads >= tp->numWorkers ||
+	    ( tp->attr.maxThreads != INFINITE_THREADS &&
+	      tp->totalThreads >= tp->attr.maxThreads ) ) {
+		return EMAXTHREADS;
+	}
+
+	for( i = 0; i < tp->numWorkers; i++ ) {
+		if( !tp->workers[i].running ) {
+			w = &tp->workers[i];
+			break;
+		}
+	}
+	assert( w != NULL );
+
+	os_sem_init( &w->wakeup, 0 );
+	w->nextIdle = NULL;
+	w->running = 1;
+	tp->totalThreads++;
+
+	if( os_create_thread( NULL, StealingWorkerThread, w,
+	                      OS_THREADPRI_LO|OS_CRTHREAD_DETACHED, 4096+512 ) == NULL ) {
+		w->running = 0;
+		tp->totalThreads--;
+		return EAGAIN;
+	}
+
+	if( tp->stats.maxThreads < tp->totalThreads ) {
+		tp->stats.maxThreads = tp->totalThreads;
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+ * Function: InitStealingPool
+ *
+ *  Description:
+ *      Sets up the worker slots and submission stacks of a
+ *      TP_MODE_WORK_STEALING pool. One slot per allowed thread,
+ *      DEFAULT_MAX_THREADS if the maximum is infinite.
+ *      Internal to thread pool.
+ *  Parameters:
+ *      ThreadPool *tp
+ *  Returns:
+ *      0 on success, EOUTOFMEM if the slots can not be allocated.
+ *****************************************************************************/
+static int InitStealingPool( ThreadPool *tp )
+{
+	int n = tp->attr.maxThreads;
+	int i;
+
+	if( n == INFINITE_THREADS ) {
+		n = DEFAULT_MAX_THREADS;
+	}
+	if( n < tp->attr.minThreads ) {
+		n = tp->attr.minThreads;
+	}
+	if( n < 1 ) {
+		n = 1;
+	}
+
+	tp->workers = ( TPWorker * )os_alloc( n * sizeof( TPWorker ) );
+	if( tp->workers == NULL ) {
+		return EOUTOFMEM;
+	}
+	memset( tp->workers, 0, n * sizeof( TPWorker ) );
+	tp->numWorkers = n;
+
+	for( i = 0; i < n; i++ ) {
+		tp->workers[i].tp = tp;
+		ithread_mutex_init( &tp->workers[i].lock, NULL );
+	}
+
+	for( i = 0; i < NUM_PRIORITIES; i++ ) {
+		tp->inbox[i] = NULL;
+		tp->queuedJobs[i] = 0;
+	}
+	tp->idleWorkers = NULL;
+	tp->idleCount = 0;
+	ithread_mutex_init( &tp->idleLock, NULL );
+
+	return 0;
+}
+
+/****************************************************************************
+ * Function: StealingPoolAdd
+ *
+ *  Description:
+ *      ThreadPoolAdd for a TP_MODE_WORK_STEALING pool. Takes tp->mutex
+ *      only when no worker is idle and another one may be started.
+ *      Internal to thread pool.
+ *  Parameters:
+ *      see ThreadPoolAdd
+ *  Returns:
+ *      0 on success, EOUTOFMEM if not enough memory or too many jobs.
+ *****************************************************************************/
+static int StealingPoolAdd( ThreadPool *tp, ThreadPoolJob *job, int *jobId )
+{
+	ThreadPoolJob *temp = NULL;
+	int totalJobs;
+	int threads;
+
+	totalJobs = QueuedJobs( tp );
+	if( totalJobs >= tp->attr.maxJobsTotal ) {
+		fprintf(stderr, "total jobs = %d, too many jobs", totalJobs);
+		return EOUTOFMEM;
+	}
+
+	temp = ( ThreadPoolJob * )os_alloc( sizeof( ThreadPoolJob ) );
+	if( temp == NULL ) {
+		return EOUTOFMEM;
+	}
+	*temp = *job;
+	temp->jobId = TP_ADD( &tp->lastJobId, 1 ) - 1;
+	temp->next = NULL;
+	gettimeofday( &temp->requestTime, NULL );
+
+	// the job may have run and been freed once it is pushed
+	*jobId = temp->jobId;
+
+	InboxPush( tp, temp );
+	TP_ADD( &tp->queuedJobs[job->priority], 1 );
+
+	if( WakeIdleWorker( tp ) ) {
+		return 0;
+	}
+
+	// no idle worker, start one if the jobs per thread ratio asks for it
+	threads = TP_LOAD( &tp->totalThreads );
+	if( threads < tp->numWorkers &&
+	    ( threads == 0 || totalJobs / threads >= tp->attr.jobsPerThread ) ) {
+		ithread_mutex_lock( &tp->mutex );
+		threads = tp->totalThreads - tp->persistentThreads;
+		if( threads <= 0 || QueuedJobs( tp ) / threads >= tp->attr.jobsPerThread ) {
+			CreateStealingWorker( tp );
+		}
+		ithread_mutex_unlock( &tp->mutex );
+	}
+
+	return 0;
+}
+
+/****************************************************************************
+ * Function: StealingPoolAddPersistent
+ *
+ *  Description:
+ *      ThreadPoolAddPersistent for a TP_MODE_WORK_STEALING pool.
+ *      Internal to thread pool.
+ *  Parameters:
+ *      see ThreadPoolAddPersistent
+ *  Returns:
+ *      0 on success, nonzero on failure
+ *      EOUTOFMEM not enough memory to add job.
+ *      EMAXTHREADS not enough threads to add persistent job.
+ *****************************************************************************/
+static int StealingPoolAddPersistent( ThreadPool *tp, ThreadPoolJob *job, int *jobId )
+{
+	ThreadPoolJob *temp = NULL;
+
+	ithread_mutex_lock( &tp->mutex );
+
+	// Create A worker if less than max threads running
+	if( CreateStealingWorker( tp ) != 0 &&
+	    tp->totalThreads - tp->persistentThreads - 1 <= 0 ) {
+		// not more than one worker thread available
+		ithread_mutex_unlock( &tp->mutex );
+		return EMAXTHREADS;
+	}
+
+	temp = ( ThreadPoolJob * )os_alloc( sizeof( ThreadPoolJob ) );
+	if( temp == NULL ) {
+		ithread_mutex_unlock( &tp->mutex );
+		return EOUTOFMEM;
+	}
+	*temp = *job;
+	temp->jobId = TP_ADD( &tp->lastJobId, 1 ) - 1;
+	temp->next = NULL;
+	gettimeofday( &temp->requestTime, NULL );
+
+	TP_STORE( &tp->persistentJob, temp );
+	WakeIdleWorker( tp );
+
+	// wait until long job has been picked up
+	while( tp->persistentJob != NULL ) {
+		ithread_cond_wait( &tp->start_and_shutdown, &tp->mutex );
+	}
+	*jobId = temp->jobId;
+
+	ithread_mutex_unlock( &tp->mutex );
+
+	return 0;
+}
+
+/****************************************************************************
+ * Function: StealingPoolRemove
+ *
+ *  Description:
+ *      ThreadPoolRemove for a TP_MODE_WORK_STEALING pool. Moves the
+ *      submission stacks into the run queues of the first worker
+ *      slot, then searches every run queue.
+ *      Internal to thread pool.
+ *  Parameters:
+ *      see ThreadPoolRemove
+ *  Returns:
+ *      0 on success. INVALID_JOB_ID on failure.
+ *****************************************************************************/
+static int StealingPoolRemove( ThreadPool *tp, int jobId, ThreadPoolJob *out )
+{
+	ThreadPoolJob **link = NULL;
+	ThreadPoolJob *temp = NULL;
+	ThreadPoolJob *prev = NULL;
+	ThreadPoolJob *batch = NULL;
+	TPWorker *w = NULL;
+	int prio;
+	int i;
+
+	w = &tp->workers[0];
+	ithread_mutex_lock( &w->lock );
+	for( prio = 0; prio < NUM_PRIORITIES; prio++ ) {
+		batch = InboxTake( tp, prio );
+		if( batch != NULL ) {
+			RunQAppend( w, prio, batch );
+		}
+	}
+	ithread_mutex_unlock( &w->lock );
+
+	for( i = 0; i < tp->numWorkers && temp == NULL; i++ ) {
+		w = &tp->workers[i];
+		ithread_mutex_lock( &w->lock );
+		for( prio = 0; prio < NUM_PRIORITIES && temp == NULL; prio++ ) {
+			prev = NULL;
+			for( link = &w->head[prio]; *link != NULL; link = &( *link )->next ) {
+				if( ( *link )->jobId == jobId ) {
+					temp = *link;
+					__atomic_store_n( link, temp->next, __ATOMIC_RELAXED );
+					if( w->tail[prio] == temp ) {
+						w->tail[prio] = prev;
+					}
+					TP_ADD( &tp->queuedJobs[prio], -1 );
+					break;
+				}
+				prev = *link;
+			}
+		}
+		ithread_mutex_unlock( &w->lock );
+	}
+
+	// jobs moved out of the submission stacks may need a worker
+	if( QueuedJobs( tp ) > 0 ) {
+		WakeIdleWorker( tp );
+	}
+
+	if( temp == NULL ) {
+		ithread_mutex_lock( &tp->mutex );
+		if( tp->persistentJob && tp->persistentJob->jobId == jobId ) {
+			temp = tp->persistentJob;
+			TP_STORE( &tp->persistentJob, NULL );
+		}
+		ithread_mutex_unlock( &tp->mutex );
+	}
+
+	if( temp == NULL ) {
+		return INVALID_JOB_ID;
+	}
+
+	*out = *temp;
+	out->next = NULL;
+	os_free( temp );
+
+	return 0;
+}
+
+/****************************************************************************
+ * Function: FreeJobChain
+ *
+ *  Description:
+ *      Frees a chain of jobs that will not run and their arguments.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPoolJob *job - chain linked through next
+ *****************************************************************************/
+static void FreeJobChain( ThreadPoolJob *job )
+{
+	ThreadPoolJob *next = NULL;
+
+	while( job != NULL ) {
+		next = job->next;
+		if( job->free_func ) {
+			job->free_func( job->arg );
+		}
+		os_free( job );
+		job = next;
+	}
+}
+
+/****************************************************************************
+ * Function: StopStealingWorkers
+ *
+ *  Description:
+ *      Wakes every worker of a TP_MODE_WORK_STEALING pool, waits for
+ *      all of them to exit and frees the jobs that never ran.
+ *      tp->mutex must be locked.
+ *      Internal to thread pool.
+ *  Parameters:
+ *      ThreadPool *tp
+ *****************************************************************************/
+static void StopStealingWorkers( ThreadPool *tp )
+{
+	int prio;
+	int i;
+
+	TP_STORE( &tp->shutdown, 1 );
+	if( tp->workers == NULL ) {
+		return;
+	}
+
+	for( i = 0; i < tp->numWorkers; i++ ) {
+		if( tp->workers[i].running ) {
+			os_sem_post( &tp->workers[i].wakeup );
+		}
+	}
+
+	// wait for all threads to finish
+	while( tp->totalThreads > 0 ) {
+		ithread_cond_wait( &tp->start_and_shutdown, &tp->mutex );
+	}
+
+	for( prio = 0; prio < NUM_PRIORITIES; prio++ ) {
+		FreeJobChain( InboxTake( tp, prio ) );
+		for( i = 0; i < tp->numWorkers; i++ ) {
+			FreeJobChain( tp->workers[i].head[prio] );
+		}
+	}
+
+	FreeJobChain( tp->persistentJob );
+	tp->persistentJob = NULL;
+
+	// worker locks and semaphores hold no resources
+	os_free( tp->workers );
+	tp->workers = NULL;
+	tp->numWorkers = 0;
+}
+
 /****************************************************************************
  * Function: CreateThreadPoolJob
  *
@@ -639,6 +1536,10 @@ static int CreateWorker( ThreadPool *tp )
 
 	assert( tp != NULL );
 
+	if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+		return CreateStealingWorker( tp );
+	}
+
 	if ( tp->attr.maxThreads != INFINITE_THREADS &&
 	     currentThreads > tp->attr.maxThreads ) {
 		return EMAXTHREADS;
@@ -738,6 +1639,9 @@ int ThreadPoolInit( ThreadPool *tp, ThreadPoolAttr *attr )
 #endif
 #endif
 
+	tp->workers = NULL;
+	tp->numWorkers = 0;
+
 	retCode += ithread_mutex_init( &tp->mutex, NULL );
 	assert( retCode == 0 );
 
@@ -791,7 +1695,10 @@ int ThreadPoolInit( ThreadPool *tp, ThreadPoolAttr *attr )
 		tp->shutdown = 0;
 		tp->totalThreads = 0;
 		tp->persistentThreads = 0;
-		for( i = 0; i < tp->attr.minThreads; ++i ) {
+		if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+			retCode = InitStealingPool( tp );
+		}
+		for( i = 0; retCode == 0 && i < tp->attr.minThreads; ++i ) {
 			if( ( retCode = CreateWorker( tp ) ) != 0 ) {
 				break;
 			}
@@ -844,12 +1751,16 @@ int ThreadPoolAddPersistent( ThreadPool *tp, ThreadPoolJob *job, int *jobId )
 
 	*jobId = INVALID_JOB_ID;
 
-	ithread_mutex_lock( &tp->mutex );
-
 	assert( job->priority == LOW_PRIORITY ||
 	        job->priority == MED_PRIORITY ||
 	        job->priority == HIGH_PRIORITY );
 
+	if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+		return StealingPoolAddPersistent( tp, job, jobId );
+	}
+
+	ithread_mutex_lock( &tp->mutex );
+
 	// Create A worker if less than max threads running
 	if( tp->totalThreads < tp->attr.maxThreads ) {
 		CreateWorker( tp );
@@ -919,12 +1830,20 @@ int ThreadPoolAdd( ThreadPool *tp, ThreadPoolJob *job, int *jobId )
 		return EINVAL;
 	}
 
-	ithread_mutex_lock( &tp->mutex );
-
 	assert( job->priority == LOW_PRIORITY ||
 	job->priority == MED_PRIORITY ||
 	job->priority == HIGH_PRIORITY );
 
+	if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+		if( jobId == NULL ) {
+			jobId = &tempId;
+		}
+		*jobId = INVALID_JOB_ID;
+		return StealingPoolAdd( tp, job, jobId );
+	}
+
+	ithread_mutex_lock( &tp->mutex );
+
 	totalJobs = tp->highJobQ.size + tp->lowJobQ.size + tp->medJobQ.size;
 	if (totalJobs >= tp->attr.maxJobsTotal) {
 		fprintf(stderr, "total jobs = %d, too many jobs", totalJobs);
@@ -1008,6 +1927,10 @@ int ThreadPoolRemove( ThreadPool *tp, int jobId, ThreadPoolJob *out )
 
 	dummy.jobId = jobId;
 
+	if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+		return StealingPoolRemove( tp, jobId, out );
+	}
+
 	ithread_mutex_lock( &tp->mutex );
 
 	tempNode = ListFind( &tp->highJobQ, NULL, &dummy );
@@ -1128,6 +2051,8 @@ int ThreadPoolSetAttr( ThreadPool *tp, ThreadPoolAttr *attr )
 		return INVALID_POLICY;
 	}
 
+	// the mode is fixed when the pool is created
+	temp.mode = tp->attr.mode;
 	tp->attr = ( temp );
 
 	// add threads
@@ -1178,6 +2103,10 @@ int ThreadPoolShutdown( ThreadPool *tp )
 
 	ithread_mutex_lock( &tp->mutex );
 
+	if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+		StopStealingWorkers( tp );
+	}
+
 	// clean up high priority jobs
 	while( tp->highJobQ.size ) {
 		head = ListHead( &tp->highJobQ );
@@ -1275,6 +2204,7 @@ int TPAttrInit( ThreadPoolAttr *attr )
 	attr->schedPolicy    = DEFAULT_POLICY;
 	attr->starvationTime = DEFAULT_STARVATION_TIME;
 	attr->maxJobsTotal   = DEFAULT_MAX_JOBS_TOTAL;
+	attr->mode           = DEFAULT_POOL_MODE;
 
 	return 0;
 }
@@ -1519,6 +2449,29 @@ int TPAttrSetMaxJobsTotal( ThreadPoolAttr *attr, int  maxJobsTotal )
 	return 0;
 }
 
+/****************************************************************************
+ * Function: TPAttrSetMode
+ *
+ *  Description:
+ *      Selects the shared queue or the work stealing scheduler.
+ *  Parameters:
+ *      attr - must be valid thread pool attributes.
+ *      mode - TP_MODE_SHARED_QUEUE or TP_MODE_WORK_STEALING
+ *  Returns:
+ *      Always returns 0.
+ *****************************************************************************/
+int TPAttrSetMode( ThreadPoolAttr *attr, ThreadPoolMode mode )
+{
+	assert( attr != NULL );
+	if( attr == NULL ) {
+		return EINVAL;
+	}
+
+	attr->mode = mode;
+
+	return 0;
+}
+
 #ifdef STATS
 void ThreadPoolPrintStats(ThreadPoolStats *stats)
 {
@@ -1545,9 +2498,49 @@ void ThreadPoolPrintStats(ThreadPoolStats *stats)
 	printf("Total Threads : %d\n", stats->totalThreads);
 	printf("Total Time spent Working in seconds: %f\n", stats->totalWorkTime);
 	printf("Total Time spent Idle in seconds : %f\n", stats->totalIdleTime);
+	printf("Total Jobs stolen by idle workers: %d\n", stats->totalJobsStolen);
 }
 #endif /* STATS */
 
+#ifdef STATS
+/****************************************************************************
+ * Function: StealingPoolStats
+ *
+ *  Description:
+ *      Adds the counters kept by the workers of a TP_MODE_WORK_STEALING
+ *      pool to the statistics. Work and idle time are not tracked in
+ *      this mode.
+ *      Internal Only.
+ *  Parameters:
+ *      ThreadPool *tp
+ *      ThreadPoolStats *stats - copy of tp->stats
+ *****************************************************************************/
+static void StealingPoolStats( ThreadPool *tp, ThreadPoolStats *stats )
+{
+	TPWorker *w = NULL;
+	int i;
+
+	for( i = 0; i < tp->numWorkers; i++ ) {
+		w = &tp->workers[i];
+		stats->totalJobsHQ += w->jobs[HIGH_PRIORITY];
+		stats->totalTimeHQ += w->waitTime[HIGH_PRIORITY];
+		stats->totalJobsMQ += w->jobs[MED_PRIORITY];
+		stats->totalTimeMQ += w->waitTime[MED_PRIORITY];
+		stats->totalJobsLQ += w->jobs[LOW_PRIORITY];
+		stats->totalTimeLQ += w->waitTime[LOW_PRIORITY];
+		stats->totalJobsStolen += w->stolen;
+	}
+
+	stats->currentJobsHQ = TP_LOAD( &tp->queuedJobs[HIGH_PRIORITY] );
+	stats->currentJobsMQ = TP_LOAD( &tp->queuedJobs[MED_PRIORITY] );
+	stats->currentJobsLQ = TP_LOAD( &tp->queuedJobs[LOW_PRIORITY] );
+	stats->idleThreads = TP_LOAD( &tp->idleCount );
+	stats->workerThreads = tp->totalThreads - tp->persistentThreads -
+	                       stats->idleThreads;
+}
+
+#endif /* STATS */
+
 /****************************************************************************
  * Function: ThreadPoolGetStats
  *
@@ -1576,6 +2569,9 @@ int ThreadPoolGetStats( ThreadPool *tp, ThreadPoolStats *stats )
 	}
 
 	*stats = tp->stats;
+	if( tp->attr.mode == TP_MODE_WORK_STEALING ) {
+		StealingPoolStats( tp, stats );
+	}
 	if (stats->totalJobsHQ > 0) {
 		stats->avgWaitHQ = stats->totalTimeHQ / stats->totalJobsHQ;
 	} else {
@@ -1596,9 +2592,11 @@ int ThreadPoolGetStats( ThreadPool *tp, ThreadPoolStats *stats )
 
 	stats->totalThreads = tp->totalThreads;
 	stats->persistentThreads = tp->persistentThreads;
-	stats->currentJobsHQ = ListSize( &tp->highJobQ );
-	stats->currentJobsLQ = ListSize( &tp->lowJobQ );
-	stats->currentJobsMQ = ListSize( &tp->medJobQ );
+	if( tp->attr.mode != TP_MODE_WORK_STEALING ) {
+		stats->currentJobsHQ = ListSize( &tp->highJobQ );
+		stats->currentJobsLQ = ListSize( &tp->lowJobQ );
+		stats->currentJobsMQ = ListSize( &tp->medJobQ );
+	}
 
 	//if not shutdown then release mutex
 	if( !tp->shutdown ) {
@@ -0,0 +1,269 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// ThreadPool scheduling benchmark run on the host.
+//
+// For 1 up to N submitting threads, with as many pool workers, every
+// submitter adds short jobs as fast as the pool accepts them. The run
+// reports jobs per second and the time from ThreadPoolAdd to the start
+// of the job, for the shared queue and the work stealing mode. Before
+// that, each mode is checked to run every job exactly once, to hand
+// over a persistent job, to remove a queued job and to free the jobs
+// left at shutdown.
+//
+// See bench_threadpool.sh for the build.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_JOBS	200000
+#define MAX_CORES	16
+
+static const char *mode_names[] = { "shared", "stealing" };
+
+static ThreadPool pool;
+static int submitters;
+static int jobs_per_submitter;
+static uint64_t *submit_ns;
+static uint32_t *latency_ns;
+static int jobs_done;
+static int jobs_freed;
+static volatile int go;
+
+static uint64_t
+now_ns (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+init_pool (ThreadPoolMode mode, int threads)
+{
+	ThreadPoolAttr attr;
+
+	TPAttrInit (&attr);
+	TPAttrSetMinThreads (&attr, threads);
+	TPAttrSetMaxThreads (&attr, threads);
+	TPAttrSetJobsPerThread (&attr, 10);
+	TPAttrSetIdleTime (&attr, 5000);
+	TPAttrSetMaxJobsTotal (&attr, 1 << 30);
+	TPAttrSetMode (&attr, mode);
+	if (ThreadPoolInit (&pool, &attr) != 0) {
+		fprintf (stderr, "ThreadPoolInit failed\n");
+		exit (1);
+	}
+}
+
+static void *
+bench_job (void *arg)
+{
+	int i = (int)(intptr_t)arg;
+
+	latency_ns[i] = (uint32_t)(now_ns () - submit_ns[i]);
+	__atomic_add_fetch (&jobs_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+static void
+free_job_arg (void *arg)
+{
+	(void)arg;
+	__atomic_add_fetch (&jobs_freed, 1, __ATOMIC_RELAXED);
+}
+
+static void *
+submitter (void *arg)
+{
+	int first = (int)(intptr_t)arg * jobs_per_submitter;
+	ThreadPoolJob job;
+	int i;
+
+	while (!go)
+		;
+
+	for (i = first; i < first + jobs_per_submitter; i++) {
+		TPJobInit (&job, bench_job, (void *)(intptr_t)i);
+		TPJobSetPriority (&job, (i & 7) == 0 ? HIGH_PRIORITY : MED_PRIORITY);
+		submit_ns[i] = now_ns ();
+		while (ThreadPoolAdd (&pool, &job, NULL) != 0)
+			sched_yield ();
+	}
+
+	return NULL;
+}
+
+static int
+cmp_u32 (const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void
+run_bench (ThreadPoolMode mode, int cores)
+{
+	pthread_t threads[MAX_CORES];
+	uint64_t start, elapsed;
+	int total, i;
+
+	submitters = cores;
+	jobs_per_submitter = BENCH_JOBS / cores;
+	total = jobs_per_submitter * cores;
+	jobs_done = 0;
+	go = 0;
+
+	init_pool (mode, cores);
+	for (i = 0; i < cores; i++)
+		pthread_create (&threads[i], NULL, submitter, (void *)(intptr_t)i);
+
+	start = now_ns ();
+	go = 1;
+	for (i = 0; i < cores; i++)
+		pthread_join (threads[i], NULL);
+	while (__atomic_load_n (&jobs_done, __ATOMIC_ACQUIRE) < total)
+		sched_yield ();
+	elapsed = now_ns () - start;
+	ThreadPoolShutdown (&pool);
+
+	qsort (latency_ns, total, sizeof (latency_ns[0]), cmp_u32);
+	printf ("bench: %-8s %2d cores %9.0f jobs/s  latency p50 %7.1f us"
+		"  p99 %8.1f us  max %8.1f us\n",
+		mode_names[mode], cores, total * 1e9 / elapsed,
+		latency_ns[total / 2] / 1e3, latency_ns[total * 99 / 100] / 1e3,
+		latency_ns[total - 1] / 1e3);
+}
+
+static int persistent_started;
+static volatile int persistent_stop;
+
+static void *
+persistent_job (void *arg)
+{
+	(void)arg;
+	__atomic_store_n (&persistent_started, 1, __ATOMIC_RELEASE);
+	while (!persistent_stop)
+		usleep (1000);
+	return NULL;
+}
+
+static void *
+blocking_job (void *arg)
+{
+	(void)arg;
+	while (!persistent_stop)
+		usleep (1000);
+	return NULL;
+}
+
+static int
+check_mode (ThreadPoolMode mode)
+{
+	ThreadPoolJob job, removed;
+	ThreadPoolStats stats;
+	int i, id, failed = 0;
+
+	// every job runs once
+	memset (latency_ns, 0, BENCH_JOBS * sizeof (latency_ns[0]));
+	jobs_done = 0;
+	init_pool (mode, 4);
+	for (i = 0; i < 10000; i++) {
+		TPJobInit (&job, bench_job, (void *)(intptr_t)i);
+		TPJobSetPriority (&job, (ThreadPriority)(i % 3));
+		submit_ns[i] = now_ns ();
+		if (ThreadPoolAdd (&pool, &job, NULL) != 0) {
+			printf ("%s: ThreadPoolAdd failed\n", mode_names[mode]);
+			failed = 1;
+		}
+	}
+	while (__atomic_load_n (&jobs_done, __ATOMIC_ACQUIRE) < 10000)
+		sched_yield ();
+	ThreadPoolGetStats (&pool, &stats);
+	if (stats.totalJobsHQ + stats.totalJobsMQ + stats.totalJobsLQ != 10000) {
+		printf ("%s: stats count %d jobs\n", mode_names[mode],
+			stats.totalJobsHQ + stats.totalJobsMQ + stats.totalJobsLQ);
+		failed = 1;
+	}
+	ThreadPoolShutdown (&pool);
+	if (jobs_done != 10000) {
+		printf ("%s: %d jobs ran\n", mode_names[mode], jobs_done);
+		failed = 1;
+	}
+
+	// persistent handoff, remove and free at shutdown with the only
+	// other worker blocked
+	persistent_started = 0;
+	persistent_stop = 0;
+	jobs_freed = 0;
+	init_pool (mode, 2);
+	TPJobInit (&job, persistent_job, NULL);
+	if (ThreadPoolAddPersistent (&pool, &job, NULL) != 0 ||
+	    !__atomic_load_n (&persistent_started, __ATOMIC_ACQUIRE)) {
+		usleep (10000);
+	}
+	if (!__atomic_load_n (&persistent_started, __ATOMIC_ACQUIRE)) {
+		printf ("%s: persistent job not started\n", mode_names[mode]);
+		failed = 1;
+	}
+	TPJobInit (&job, blocking_job, NULL);
+	ThreadPoolAdd (&pool, &job, NULL);
+	usleep (10000);
+	for (i = 0; i < 5; i++) {
+		TPJobInit (&job, bench_job, (void *)(intptr_t)i);
+		TPJobSetFreeFunction (&job, free_job_arg);
+		ThreadPoolAdd (&pool, &job, &id);
+	}
+	if (ThreadPoolRemove (&pool, id, &removed) != 0 ||
+	    removed.arg != (void *)(intptr_t)4) {
+		printf ("%s: ThreadPoolRemove failed\n", mode_names[mode]);
+		failed = 1;
+	}
+	if (ThreadPoolRemove (&pool, id, &removed) != INVALID_JOB_ID) {
+		printf ("%s: job removed twice\n", mode_names[mode]);
+		failed = 1;
+	}
+	jobs_done = 0;
+	persistent_stop = 1;
+	ThreadPoolShutdown (&pool);
+	if (jobs_done + jobs_freed != 4) {
+		printf ("%s: %d queued jobs ran, %d freed, expected 4\n",
+			mode_names[mode], jobs_done, jobs_freed);
+		failed = 1;
+	}
+
+	printf ("%s: %s\n", mode_names[mode], failed ? "FAILED" : "ok");
+	return failed;
+}
+
+int
+main (int argc, char* argv[])
+{
+	int cores, n, failed = 0;
+
+	submit_ns = calloc (BENCH_JOBS, sizeof (submit_ns[0]));
+	latency_ns = calloc (BENCH_JOBS, sizeof (latency_ns[0]));
+
+	failed |= check_mode (TP_MODE_SHARED_QUEUE);
+	failed |= check_mode (TP_MODE_WORK_STEALING);
+	if (failed)
+		return 1;
+
+	if (argc > 1 && strcmp (argv[1], "-b") == 0) {
+		cores = sysconf (_SC_NPROCESSORS_ONLN);
+		if (cores > MAX_CORES)
+			cores = MAX_CORES;
+		for (n = 1; n <= cores; n *= 2) {
+			run_bench (TP_MODE_SHARED_QUEUE, n);
+			run_bench (TP_MODE_WORK_STEALING, n);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,32 @@
+#!/bin/sh
+#
+# Builds the thread pool with the host compiler and runs the checks of
+# bench_threadpool under ThreadSanitizer. With -b, an optimized build
+# also runs the benchmark.
+#
+srcdir=${srcdir:-`dirname $0`/..}
+CC=${CC:-cc}
+
+# ithread_*_destroy hand the mutex to os_free, which glibc rejects for
+# a mutex inside a ThreadPool
+build() {
+	out=$1
+	shift
+	$CC "$@" -w -D_GNU_SOURCE -pthread \
+		-I$srcdir/test/host -I$srcdir/inc \
+		-c $srcdir/src/ThreadPool.c $srcdir/src/LinkedList.c \
+		$srcdir/src/FreeList.c $srcdir/test/bench_threadpool.c &&
+	$CC "$@" -w -D_GNU_SOURCE -D'os_free(p)=((void)(p))' -pthread \
+		-I$srcdir/test/host -I$srcdir/inc \
+		-c $srcdir/src/ithread.c &&
+	$CC "$@" -pthread -o $out ThreadPool.o LinkedList.o FreeList.o \
+		ithread.o bench_threadpool.o
+}
+
+build test_threadpool -g -O1 -fsanitize=thread || exit 1
+./test_threadpool || exit 1
+
+if [ "$1" = "-b" ]; then
+	build bench_threadpool -O2 -DNDEBUG || exit 1
+	./bench_threadpool -b
+fi
@@ -0,0 +1,122 @@
+// Host stand-in for the kernel header, for running the thread pool on Linux.
+#ifndef _HOST_KERNEL_OS_H
+#define _HOST_KERNEL_OS_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+// the target has no POSIX scheduling, keep ThreadPool off sched_*()
+#undef _POSIX_PRIORITY_SCHEDULING
+
+#define os_alloc	malloc
+#define os_realloc	realloc
+#ifndef os_free
+#define os_free		free
+#endif
+
+#define SYSTIME_MS(_n)	((_n) * 1000)
+#define SYSTIME_US(_n)	((_n) * 1)
+
+#define OS_THREADPRI_LO		0
+#define OS_CRTHREAD_DETACHED	(1 << 4)
+
+typedef void *os_threadarg_t;
+typedef void *(*os_entrypoint_t)(os_threadarg_t);
+
+struct os_thread {
+	pthread_t id;
+};
+
+struct os_semaphore {
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	int             value;
+};
+
+static inline void os_sem_init(struct os_semaphore *sem, int value)
+{
+	pthread_mutex_init(&sem->lock, NULL);
+	pthread_cond_init(&sem->cond, NULL);
+	sem->value = value;
+}
+
+static inline void os_sem_wait(struct os_semaphore *sem)
+{
+	pthread_mutex_lock(&sem->lock);
+	while (sem->value == 0)
+		pthread_cond_wait(&sem->cond, &sem->lock);
+	sem->value--;
+	pthread_mutex_unlock(&sem->lock);
+}
+
+/* tmo in microseconds; 0 on success, nonzero on timeout */
+static inline int os_sem_wait_timeout(struct os_semaphore *sem, uint32_t tmo)
+{
+	struct timespec ts;
+	int rc = 0;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += tmo / 1000000;
+	ts.tv_nsec += (tmo % 1000000) * 1000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&sem->lock);
+	while (sem->value == 0 && rc == 0)
+		rc = pthread_cond_timedwait(&sem->cond, &sem->lock, &ts);
+	if (sem->value > 0) {
+		sem->value--;
+		rc = 0;
+	}
+	pthread_mutex_unlock(&sem->lock);
+
+	return rc;
+}
+
+static inline void os_sem_post(struct os_semaphore *sem)
+{
+	pthread_mutex_lock(&sem->lock);
+	sem->value++;
+	pthread_cond_signal(&sem->cond);
+	pthread_mutex_unlock(&sem->lock);
+}
+
+static inline struct os_thread *os_create_thread(const char *name,
+	os_entrypoint_t entry, os_threadarg_t arg, uint32_t flags, size_t stacksz)
+{
+	static struct os_thread detached;
+	pthread_t id;
+
+	(void)name;
+	(void)flags;
+	(void)stacksz;
+	if (pthread_create(&id, NULL, entry, arg) != 0)
+		return NULL;
+	pthread_detach(id);
+
+	return &detached;
+}
+
+static inline struct os_thread *os_self(void)
+{
+	return NULL;
+}
+
+static inline void *os_join_thread(struct os_thread *thread)
+{
+	(void)thread;
+	return NULL;
+}
+
+static inline void os_msleep(uint32_t time)
+{
+	usleep(time * 1000);
+}
+
+#endif
@@ -235,6 +235,15 @@ int UpnpInit( IN const char *HostIP,
     }
 #endif
 
+    // initialize SSDP packet cache mutex
+#ifdef INCLUDE_DEVICE_APIS
+#if EXCLUDE_SSDP == 0
+    if (ithread_mutex_init(&gSsdpCacheMutex, NULL) != 0) {
+        return UPNP_E_INIT_FAILED;
+    }
+#endif
+#endif
+
     //HandleLock();
     if( HostIP != NULL ) {
         strcpy( LOCAL_HOST, HostIP );
@@ -455,6 +464,11 @@ UpnpFinish()
 
 #ifdef INCLUDE_CLIENT_APIS
     ithread_mutex_destroy(&GlobalClientSubscribeMutex);
+#endif
+#ifdef INCLUDE_DEVICE_APIS
+#if EXCLUDE_SSDP == 0
+    ithread_mutex_destroy(&gSsdpCacheMutex);
+#endif
 #endif
     /*ithread_rwlock_destroy(&GlobalHndRWLock);*/
     ithread_mutex_destroy(&gUUIDMutex);
@@ -667,6 +681,7 @@ UpnpRegisterRootDevice( IN const char *DescUrl,
     CLIENTONLY( HInfo->ClientSubList = NULL; )
     HInfo->MaxSubscriptions = UPNP_INFINITE;
     HInfo->MaxSubscriptionTimeOut = UPNP_INFINITE;
+    HInfo->SsdpCache = NULL;
     if( ( retVal =
           //UpnpDownloadXmlDoc( HInfo->DescURL, &( HInfo->DescDocument ) ) )
           UpnpGetXmlDoc(HInfo->DescXML, &( HInfo->DescDocument ) ) )
@@ -718,6 +733,11 @@ UpnpRegisterRootDevice( IN const char *DescUrl,
 //            "\nUpnpRegisterRootDevice2: Empty service table\n" );
     }
 
+#if EXCLUDE_SSDP == 0
+    // build the SSDP packet set once; it is rebuilt on demand if this fails
+    SsdpPacketCacheBuild( HInfo, HInfo->MaxAge );
+#endif
+
     UpnpSdkDeviceRegistered = 1;
 //    HandleUnlock();//it seems useless//////////////////////
 //    UpnpPrintf( UPNP_INFO, API, __FILE__, __LINE__,
@@ -856,6 +876,9 @@ UpnpUnRegisterRootDevice( IN UpnpDevice_Handle Hnd )
         return UPNP_E_INVALID_HANDLE;
     }
     //info = (struct Handle_Info *) HandleTable[Hnd];
+#if EXCLUDE_SSDP == 0
+    SsdpPacketCacheInvalidate( HInfo );
+#endif
     ixmlNodeList_free( HInfo->DeviceList );
     ixmlNodeList_free( HInfo->ServiceList );
     ixmlDocument_free( HInfo->DescDocument );
@@ -1234,6 +1257,7 @@ UpnpRegisterRootDevice2( IN Upnp_DescType descriptionType,
     CLIENTONLY( HInfo->ClientSubList = NULL; )
     HInfo->MaxSubscriptions = UPNP_INFINITE;
     HInfo->MaxSubscriptionTimeOut = UPNP_INFINITE;
+    HInfo->SsdpCache = NULL;
 
     //UpnpPrintf( UPNP_ALL, API, __FILE__, __LINE__,
     //    "UpnpRegisterRootDevice2: Valid Description\n" );
@@ -1278,6 +1302,11 @@ UpnpRegisterRootDevice2( IN Upnp_DescType descriptionType,
         //    "\nUpnpRegisterRootDevice2: Empty service table\n" );
     }
 
+#if EXCLUDE_SSDP == 0
+    // build the SSDP packet set once; it is rebuilt on demand if this fails
+    SsdpPacketCacheBuild( HInfo, HInfo->MaxAge );
+#endif
+
     UpnpSdkDeviceRegistered = 1;
     //HandleUnlock();
     //UpnpPrintf( UPNP_ALL, API, __FILE__, __LINE__,
@@ -154,7 +154,8 @@ is_separator_char( IN char c )
 * Parameters :
 *	IN char c ;	character to be tested for separator values
 *
-* Description :	Calls the function to indentify separator character 
+* Description :	Tells whether c is a token character, i.e. a printable
+*	char that is not a separator
 *
 * Return : xboolean ;
 *
@@ -163,7 +164,13 @@ is_separator_char( IN char c )
 static UPNP_INLINE xboolean
 is_identifier_char( IN char c )
 {
-    return ( c >= 32 && c <= 126 ) && !is_separator_char( c );
+    // bitmap of 32..126 minus the separators above, one bit per char
+    static const uint32_t token_chars[4] = {
+        0x00000000, 0x03ff6cfa, 0xc7fffffe, 0x57ffffff
+    };
+    unsigned char uc = ( unsigned char )c;
+
+    return uc < 128 && ( token_chars[uc >> 5] & ( 1u << ( uc & 31 ) ) );
 }
 
 /************************************************************************
@@ -464,10 +471,109 @@ httpheader_free( void *msg )
     http_header_t *hdr = ( http_header_t * ) msg;
 
     membuffer_destroy( &hdr->name_buf );
-    membuffer_destroy( &hdr->value );
+    if( !hdr->in_msg ) {
+        membuffer_destroy( &hdr->value );
+    }
     os_free( hdr );
 }
 
+/************************************************************************
+* Function :	httpheader_resolve
+*
+* Parameters :
+*	IN http_message_t* msg ;	HTTP Message Object
+*	INOUT http_header_t* hdr ;	header of 'msg'
+*
+* Description :	Points the name and value of a header that lives in the
+*	raw message at the current message buffer. The buffer moves when
+*	more data is appended to it, so only the offsets are stable.
+*
+* Return : void ;
+*
+* Note :
+************************************************************************/
+static UPNP_INLINE void
+httpheader_resolve( IN http_message_t * msg,
+                    INOUT http_header_t * hdr )
+{
+    if( hdr->in_msg && msg->msg.buf != NULL ) {
+        hdr->name.buf = msg->msg.buf + hdr->name_offset;
+        hdr->value.buf = msg->msg.buf + hdr->value_offset;
+    }
+}
+
+/************************************************************************
+* Function :	httpmsg_resolve_hdrs
+*
+* Parameters :
+*	IN http_message_t* msg ;	HTTP Message Object
+*
+* Description :	Calls httpheader_resolve() on every header of the
+*	message, for the code that walks the header list directly.
+*
+* Return : void ;
+*
+* Note :
+************************************************************************/
+static void
+httpmsg_resolve_hdrs( IN http_message_t * msg )
+{
+    ListNode *node;
+
+    node = ListHead( &msg->headers );
+    while( node != NULL ) {
+        httpheader_resolve( msg, ( http_header_t * ) node->item );
+        node = ListNext( &msg->headers, node );
+    }
+}
+
+/************************************************************************
+* Function :	httpheader_own
+*
+* Parameters :
+*	IN http_message_t* msg ;	HTTP Message Object
+*	INOUT http_header_t* hdr ;	header of 'msg'
+*
+* Description :	Copies the name and value of a header out of the raw
+*	message, so that the value can be modified.
+*
+* Return : int ;
+*	0 on success; UPNP_E_OUTOF_MEMORY otherwise
+*
+* Note :
+************************************************************************/
+static int
+httpheader_own( IN http_message_t * msg,
+                INOUT http_header_t * hdr )
+{
+    memptr value;
+
+    if( !hdr->in_msg ) {
+        return 0;
+    }
+
+    httpheader_resolve( msg, hdr );
+    value.buf = hdr->value.buf;
+    value.length = hdr->value.length;
+
+    membuffer_init( &hdr->value );
+    if( membuffer_assign( &hdr->name_buf, hdr->name.buf,
+                          hdr->name.length ) != 0 ||
+        membuffer_assign( &hdr->value, value.buf, value.length ) != 0 ) {
+        // leave the header pointing into the message
+        membuffer_destroy( &hdr->name_buf );
+        membuffer_destroy( &hdr->value );
+        hdr->value.buf = value.buf;
+        hdr->value.length = value.length;
+        return UPNP_E_OUTOF_MEMORY;
+    }
+
+    hdr->name.buf = hdr->name_buf.buf;
+    hdr->in_msg = FALSE;
+
+    return 0;
+}
+
 /************************************************************************
 * Function :	httpmsg_init
 *
@@ -487,6 +593,7 @@ httpmsg_init( INOUT http_message_t * msg )
     msg->entity.buf = NULL;
     msg->entity.length = 0;
     ListInit( &msg->headers, httpmsg_compare, httpheader_free );
+    memset( msg->hdr_index, 0, sizeof( msg->hdr_index ) );
     membuffer_init( &msg->msg );
     membuffer_init( &msg->status_msg );
 }
@@ -510,6 +617,7 @@ httpmsg_destroy( INOUT http_message_t * msg )
 
     if( msg->initialized == 1 ) {
         ListDestroy( &msg->headers, 1 );
+        memset( msg->hdr_index, 0, sizeof( msg->hdr_index ) );
         membuffer_destroy( &msg->msg );
         membuffer_destroy( &msg->status_msg );
         os_free( msg->urlbuf );
@@ -518,23 +626,23 @@ httpmsg_destroy( INOUT http_message_t * msg )
 }
 
 /************************************************************************
-* Function :	httpmsg_find_hdr_str
+* Function :	httpmsg_find_unknown_hdr
 *
 * Parameters :
 *	IN http_message_t* msg ;	HTTP Message Object
-*	IN const char* header_name ; Header name to be compared with
+*	IN memptr* name ;		Header name to be compared with
 *
-* Description :	Compares the header name with the header names stored
-*	in	the linked list of messages
+* Description :	Walks the headers that have no name id and compares
+*	their names with 'name', ignoring case.
 *
 * Return : http_header_t* - Pointer to a header on success;
 *		 NULL on failure
 *
 * Note :
 ************************************************************************/
-http_header_t *
-httpmsg_find_hdr_str( IN http_message_t * msg,
-                      IN const char *header_name )
+static http_header_t *
+httpmsg_find_unknown_hdr( IN http_message_t * msg,
+                          IN memptr * name )
 {
     http_header_t *header;
 
@@ -545,8 +653,13 @@ httpmsg_find_hdr_str( IN http_message_t * msg,
 
         header = ( http_header_t * ) node->item;
 
-        if( memptr_cmp_nocase( &header->name, header_name ) == 0 ) {
-            return header;
+        if( header->name_id == HDR_UNKNOWN &&
+            header->name.length == name->length ) {
+            httpheader_resolve( msg, header );
+            if( strncasecmp( header->name.buf, name->buf,
+                             name->length ) == 0 ) {
+                return header;
+            }
         }
 
         node = ListNext( &msg->headers, node );
@@ -554,6 +667,42 @@ httpmsg_find_hdr_str( IN http_message_t * msg,
     return NULL;
 }
 
+/************************************************************************
+* Function :	httpmsg_find_hdr_str
+*
+* Parameters :
+*	IN http_message_t* msg ;	HTTP Message Object
+*	IN const char* header_name ; Header name to be compared with
+*
+* Description :	Compares the header name with the header names stored
+*	in	the linked list of messages. Known header names are
+*	looked up in the header index instead of walking the list.
+*
+* Return : http_header_t* - Pointer to a header on success;
+*		 NULL on failure
+*
+* Note :
+************************************************************************/
+http_header_t *
+httpmsg_find_hdr_str( IN http_message_t * msg,
+                      IN const char *header_name )
+{
+    memptr name;
+    int index;
+
+    name.buf = ( char * )header_name;
+    name.length = strlen( header_name );
+
+    // known names are in the index
+    index = map_str_to_int( name.buf, name.length, Http_Header_Names,
+                            NUM_HTTP_HEADER_NAMES, FALSE );
+    if( index != -1 ) {
+        return httpmsg_find_hdr( msg, Http_Header_Names[index].id, NULL );
+    }
+
+    return httpmsg_find_unknown_hdr( msg, &name );
+}
+
 /************************************************************************
 * Function :	httpmsg_find_hdr
 *
@@ -563,6 +712,7 @@ httpmsg_find_hdr_str( IN http_message_t * msg,
 *	OUT memptr* value ;		 Buffer to get the ouput to.
 *
 * Description :	Finds header from a list, with the given 'name_id'.
+*	Known ids are a direct lookup in the header index.
 *
 * Return : http_header_t*  - Pointer to a header on success;
 *				NULL on failure
@@ -580,15 +730,20 @@ httpmsg_find_hdr( IN http_message_t * msg,
 
     http_header_t *data;
 
-    header.name_id = header_name_id;
+    if( header_name_id >= 0 && header_name_id < NUM_HDR_IDS ) {
+        data = msg->hdr_index[header_name_id];
+    } else {
+        header.name_id = header_name_id;
 
-    node = ListFind( &msg->headers, NULL, &header );
+        node = ListFind( &msg->headers, NULL, &header );
+        data = node != NULL ? ( http_header_t * ) node->item : NULL;
+    }
 
-    if( node == NULL ) {
+    if( data == NULL ) {
         return NULL;
     }
 
-    data = ( http_header_t * ) node->item;
+    httpheader_resolve( msg, data );
 
     if( value != NULL ) {
         value->buf = data->value.buf;
@@ -1567,6 +1722,179 @@ parser_parse_responseline( INOUT http_parser_t * parser )
     return PARSE_OK;
 }
 
+/************************************************************************
+* Function: match_header_line
+*
+* Parameters:
+*	INOUT scanner_t* scanner ;	Scanner Object
+*	OUT memptr* name ;		header name
+*	OUT memptr* value ;		raw value; could be multi-lined
+*
+* Description: Matches one 'name : value CRLF' header line in a single
+*	pass over the input, or the blank line that ends the headers, in
+*	which case 'name' has length 0. Both point into the scanner buffer;
+*	whitespace around the value is trimmed. On success the scanner
+*	is moved past the line; otherwise it is left untouched, so the line
+*	is matched again once more data has been appended.
+*
+* Returns:
+*   PARSE_OK
+*   PARSE_FAILURE
+*   PARSE_INCOMPLETE
+************************************************************************/
+static parse_status_t
+match_header_line( INOUT scanner_t * scanner,
+                   OUT memptr * name,
+                   OUT memptr * value )
+{
+    char *start = scanner->msg->buf + scanner->cursor;
+    char *end = scanner->msg->buf + scanner->msg->length;
+    char *p = start;
+    char *eol;
+    char *vstart;
+    char *vend;
+
+    if( p == end ) {
+        return PARSE_INCOMPLETE;
+    }
+    // blank line ends the headers; accept \n as CRLF
+    if( *p == TOKCHAR_CR || *p == TOKCHAR_LF ) {
+        if( *p == TOKCHAR_CR ) {
+            if( ++p == end ) {
+                return PARSE_INCOMPLETE;
+            }
+            if( *p != TOKCHAR_LF ) {
+                return PARSE_FAILURE;
+            }
+        }
+        name->buf = start;
+        name->length = 0;
+        scanner->cursor += p + 1 - start;
+        return PARSE_OK;
+    }
+    // header name
+    while( p < end && is_identifier_char( *p ) ) {
+        p++;
+    }
+    if( p == start ) {
+        return PARSE_FAILURE;   // didn't see header name
+    }
+    name->buf = start;
+    name->length = p - start;
+
+    while( p < end && ( *p == ' ' || *p == '\t' ) ) {
+        p++;
+    }
+    if( p == end ) {
+        return PARSE_INCOMPLETE;
+    }
+    if( *p++ != ':' ) {
+        return PARSE_FAILURE;
+    }
+    // the value ends at the first line end not followed by whitespace;
+    // the char after the line end is needed to tell
+    vstart = p;
+    while( TRUE ) {
+        eol = memchr( p, TOKCHAR_LF, end - p );
+        if( eol == NULL || eol + 1 == end ) {
+            return PARSE_INCOMPLETE;
+        }
+        if( eol[1] != ' ' && eol[1] != '\t' ) {
+            break;
+        }
+        p = eol + 1;
+    }
+
+    // trim LWS on both sides of value
+    vend = eol;
+    while( vstart < vend && ( *vstart == ' ' || *vstart == '\t' ||
+                              *vstart == TOKCHAR_CR ||
+                              *vstart == TOKCHAR_LF ) ) {
+        vstart++;
+    }
+    while( vend > vstart && ( vend[-1] == ' ' || vend[-1] == '\t' ||
+                              vend[-1] == TOKCHAR_CR ||
+                              vend[-1] == TOKCHAR_LF ) ) {
+        vend--;
+    }
+    value->buf = vstart;
+    value->length = vend - vstart;
+
+    scanner->cursor += eol + 1 - start;
+    return PARSE_OK;
+}
+
+/************************************************************************
+* Function: parser_add_header
+*
+* Parameters:
+*	INOUT http_parser_t* parser	; HTTP Parser object
+*	IN memptr* name ;		header name, in the message buffer
+*	IN int header_id ;		header name id or HDR_UNKNOWN
+*	IN memptr* value ;		header value, in the message buffer
+*
+* Description: Adds a new header to the message. Headers refer to their
+*	name and value by offset into the message buffer; trailers of a
+*	chunked entity are copied instead, since their lines are removed
+*	from the buffer once parsed.
+*
+* Returns:
+*	PARSE_OK
+*	PARSE_FAILURE
+************************************************************************/
+static parse_status_t
+parser_add_header( INOUT http_parser_t * parser,
+                   IN memptr * name,
+                   IN int header_id,
+                   IN memptr * value )
+{
+    http_message_t *hmsg = &parser->msg;
+    http_header_t *header;
+
+    header = ( http_header_t * ) os_alloc( sizeof( http_header_t ) );
+    if( header == NULL ) {
+        parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
+        return PARSE_FAILURE;
+    }
+    membuffer_init( &header->name_buf );
+    membuffer_init( &header->value );
+    header->name_id = header_id;
+
+    if( parser->ent_position == ENTREAD_CHUNKY_HEADERS ) {
+        header->in_msg = FALSE;
+        if( membuffer_assign( &header->name_buf, name->buf,
+                              name->length ) != 0 ||
+            membuffer_assign( &header->value, value->buf,
+                              value->length ) != 0 ) {
+            // not enuf mem
+            httpheader_free( header );
+            parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
+            return PARSE_FAILURE;
+        }
+        header->name.buf = header->name_buf.buf;
+        header->name.length = header->name_buf.length;
+    } else {
+        header->in_msg = TRUE;
+        header->name_offset = name->buf - hmsg->msg.buf;
+        header->value_offset = value->buf - hmsg->msg.buf;
+        header->name = *name;
+        header->value.buf = value->buf;
+        header->value.length = value->length;
+    }
+
+    if( ListAddTail( &hmsg->headers, header ) == NULL ) {
+        httpheader_free( header );
+        parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
+        return PARSE_FAILURE;
+    }
+
+    if( header_id >= 0 && header_id < NUM_HDR_IDS ) {
+        hmsg->hdr_index[header_id] = header;
+    }
+
+    return PARSE_OK;
+}
+
 /************************************************************************
 * Function: parser_parse_headers
 *
@@ -1584,33 +1912,25 @@ parse_status_t
 parser_parse_headers( INOUT http_parser_t * parser )
 {
     parse_status_t status;
-    memptr token;
+    memptr hdr_name;
     memptr hdr_value;
-    token_type_t tok_type;
     scanner_t *scanner = &parser->scanner;
-    size_t save_pos;
-    http_header_t *header;
     int header_id;
     int ret = 0;
+    int ret2 = 0;
     int index;
     http_header_t *orig_header;
-    char save_char;
-    int ret2;
 
     assert( parser->position == POS_HEADERS ||
             parser->ent_position == ENTREAD_CHUNKY_HEADERS );
 
     while( TRUE ) {
-        save_pos = scanner->cursor;
-        //
-        // check end of headers
-        //
-        status = scanner_get_token( scanner, &token, &tok_type );
+        status = match_header_line( scanner, &hdr_name, &hdr_value );
         if( status != PARSE_OK ) {
             return status;
         }
 
-        if( tok_type == TT_CRLF ) {
+        if( hdr_name.length == 0 ) {
 
             // end of headers
             if( ( parser->msg.is_request )
@@ -1624,25 +1944,13 @@ parser_parse_headers( INOUT http_parser_t * parser )
             return PARSE_OK;
         }
         //
-        // not end; read header
-        //
-        if( tok_type != TT_IDENTIFIER ) {
-            return PARSE_FAILURE;   // didn't see header name
-        }
-
-        status = match( scanner, " : %R%c", &hdr_value );
-        if( status != PARSE_OK ) {
-            // pushback tokens; useful only on INCOMPLETE error
-            scanner->cursor = save_pos;
-            return status;
-        }
-        //
         // add header
         //
 
         // find header
-        index = map_str_to_int( token.buf, token.length, Http_Header_Names,
-                                NUM_HTTP_HEADER_NAMES, FALSE );
+        index = map_str_to_int( hdr_name.buf, hdr_name.length,
+                                Http_Header_Names, NUM_HTTP_HEADER_NAMES,
+                                FALSE );
         if( index != -1 ) {
 
             //Check if it is a soap header
@@ -1651,68 +1959,32 @@ parser_parse_headers( INOUT http_parser_t * parser )
             }
 
             header_id = Http_Header_Names[index].id;
-            orig_header =
-                httpmsg_find_hdr( &parser->msg, header_id, NULL );
+            orig_header = parser->msg.hdr_index[header_id];
         } else {
             header_id = HDR_UNKNOWN;
-
-            save_char = token.buf[token.length];
-            token.buf[token.length] = '\0';
-
-            orig_header = httpmsg_find_hdr_str( &parser->msg, token.buf );
-
-            token.buf[token.length] = save_char;    // restore
+            orig_header = httpmsg_find_unknown_hdr( &parser->msg,
+                                                    &hdr_name );
         }
 
         if( orig_header == NULL ) {
-            //
-            // add new header
-            //
-
-            header = ( http_header_t * ) os_alloc( sizeof( http_header_t ) );
-            if( header == NULL ) {
-                parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
-                return PARSE_FAILURE;
+            status = parser_add_header( parser, &hdr_name, header_id,
+                                        &hdr_value );
+            if( status != PARSE_OK ) {
+                return status;
             }
-            membuffer_init( &header->name_buf );
-            membuffer_init( &header->value );
-
-            // value can be 0 length
-            if( hdr_value.length == 0 ) {
-                hdr_value.buf = "\0";
-                hdr_value.length = 1;
-            }
-            // save in header in buffers
-            if( membuffer_assign
-                ( &header->name_buf, token.buf, token.length ) != 0
-                || membuffer_assign( &header->value, hdr_value.buf,
-                                     hdr_value.length ) != 0 ) {
-                // not enuf mem
-		free (header);
-                parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
-                return PARSE_FAILURE;
-            }
-
-            header->name.buf = header->name_buf.buf;
-            header->name.length = header->name_buf.length;
-            header->name_id = header_id;
-
-            ListAddTail( &parser->msg.headers, header );
-
-            //NNS:          ret = dlist_append( &parser->msg.headers, header );
-/** TODO: remove that? */
-            if( ret == UPNP_E_OUTOF_MEMORY ) {
-                parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
-                return PARSE_FAILURE;
-            }
-/** end of remove that? */
         } else if( hdr_value.length > 0 ) {
             //
             // append value to existing header
             //
+            if( httpheader_own( &parser->msg, orig_header ) != 0 ) {
+                parser->http_error_code = HTTP_INTERNAL_SERVER_ERROR;
+                return PARSE_FAILURE;
+            }
 
             // append space
-            ret = membuffer_append_str( &orig_header->value, ", " );
+            if( orig_header->value.length > 0 ) {
+                ret = membuffer_append_str( &orig_header->value, ", " );
+            }
 
             // append continuation of header value
             ret2 = membuffer_append( &orig_header->value,
@@ -1979,14 +2251,15 @@ parser_parse_chunky_headers( INOUT http_parser_t * parser )
         // finally, done with the whole msg
         parser->position = POS_COMPLETE;
 
-        // save entity start ptr as the very last thing to do
-        parser->msg.entity.buf = parser->msg.msg.buf +
-            parser->entity_start_position;
-
         membuffer_delete( &parser->msg.msg, save_pos,
                           ( parser->scanner.cursor - save_pos ) );
         parser->scanner.cursor = save_pos;
 
+        // save entity start ptr as the very last thing to do; the
+        // delete above may have moved the buffer
+        parser->msg.entity.buf = parser->msg.msg.buf +
+            parser->entity_start_position;
+
         return PARSE_SUCCESS;
     } else {
         return status;
@@ -2329,6 +2602,9 @@ parser_parse( INOUT http_parser_t * parser )
 
     } while( status == PARSE_OK );
 
+    // the message buffer may have moved since the headers were parsed
+    httpmsg_resolve_hdrs( &parser->msg );
+
     return status;
 
 }
@@ -2518,6 +2794,7 @@ print_http_headers( http_message_t * hmsg )
     while( node != NULL ) {
         header = ( http_header_t * ) node->item;
         // NNS: header = (http_header_t *)node->data;
+        httpheader_resolve( hmsg, header );
         os_printf( "hdr name: %.*s, value: %.*s\n", 
             (int)header->name.length, header->name.buf,
             (int)header->value.length, header->value.buf );
@@ -214,6 +214,29 @@
 #define SSDP_PACKET_DISTRIBUTE 1
 //@}
 
+/** @name SSDP_MAX_PENDING_REPLIES
+ *  The {\tt SSDP_MAX_PENDING_REPLIES} is the maximum number of M-SEARCH
+ *  replies the device keeps scheduled at any one time.  Searches that
+ *  arrive while this many replies are outstanding are dropped; control
+ *  points retransmit M-SEARCH so a dropped search is answered on retry.
+ *  This bounds the burst of replies after a network event.
+ */
+
+//@{
+#define SSDP_MAX_PENDING_REPLIES 16
+//@}
+
+/** @name SSDP_REPLY_INTERVAL
+ *  The {\tt SSDP_REPLY_INTERVAL} is the minimum spacing, in milliseconds,
+ *  between two scheduled M-SEARCH replies.  Replies are spread randomly
+ *  over the MX window requested by the control point and then pushed
+ *  apart by at least this interval.
+ */
+
+//@{
+#define SSDP_REPLY_INTERVAL 50
+//@}
+
 /** @name Module Exclusion
  *  Depending on the requirements, the user can selectively discard any of 
  *  the major modules like SOAP, GENA, SSDP or the Internal web server. By 
@@ -144,6 +144,9 @@ typedef enum // http_method_t
 #define HDR_TE                  36
 //End_Murari
 
+// size of the per-message table of known headers, indexed by HDR_ id
+#define NUM_HDR_IDS             ( HDR_TE + 1 )
+
 // status of parsing
 typedef enum // parse_status_t
 {
@@ -166,6 +169,9 @@ typedef struct // http_header_t
 
     // private
     membuffer name_buf;
+    xboolean in_msg;		// name and value point into the raw message
+    size_t name_offset;		// position of name and value in the raw
+    size_t value_offset;	//  message; valid only when in_msg is set
 } http_header_t;
 
 typedef struct // http_message_t
@@ -191,6 +197,9 @@ typedef struct // http_message_t
 //NNS:	dlist headers;			// dlist<http_header_t *>
 	memptr entity;			// message body(entity)
 
+	// first header seen for each known name id; NULL if absent
+	http_header_t *hdr_index[NUM_HDR_IDS];
+
 	// private fields
 	membuffer msg;		// entire raw message
 	char *urlbuf;	// storage for url string
@@ -261,7 +270,8 @@ void httpmsg_destroy( INOUT http_message_t* msg );
 *		IN const char* header_name ; Header name to be compared with	
 *
 *	Description :	Compares the header name with the header names stored 
-*		in	the linked list of messages
+*		in	the linked list of messages. Known header names are
+*		looked up in the header index instead of walking the list.
 *
 *	Return : http_header_t* - Pointer to a header on success;
 *			 NULL on failure														
@@ -280,6 +290,7 @@ http_header_t* httpmsg_find_hdr_str( IN http_message_t* msg,
 *		OUT memptr* value ;		 Buffer to get the ouput to.
 *
 *	Description :	Finds header from a list, with the given 'name_id'.
+*		Known ids are a direct lookup in the header index.
 *
 *	Return : http_header_t*  - Pointer to a header on success;										*
 *			 NULL on failure														
@@ -40,6 +40,7 @@
 #include "httpparser.h"
 #include "httpreadwrite.h"
 #include "miniserver.h"
+#include "ithread.h"
 #ifndef WIN32
 // #include <syslog.h>
 // #include <sys/socket.h>
@@ -158,6 +159,38 @@ typedef struct ssdpsearchreply
   
 }SsdpSearchReply;
 
+//Kind of a precomputed SSDP packet pair
+#define SSDP_PKT_ROOTDEVICE	0
+#define SSDP_PKT_DEVICEUDN	1
+#define SSDP_PKT_DEVICETYPE	2
+#define SSDP_PKT_SERVICE	3
+
+//Advertisement and reply packet for one NT/USN pair of a device
+typedef struct SsdpPacketEntry
+{
+  int Kind;          // SSDP_PKT_xxx
+  int RootDev;       // 1 if the entry belongs to the root device
+  char *Udn;         // UDN of the device owning this entry
+  char *Target;      // NT/ST value: device type, service type or UDN
+  char *Alive;       // ssdp:alive NOTIFY packet
+  char *Reply;       // HTTP 200 OK M-SEARCH reply packet
+} SsdpPacketEntry;
+
+//Full set of SSDP packets of a registered device, built once from the
+//description document and shared by advertisements and search replies
+typedef struct SsdpPacketCache
+{
+  int RefCount;
+  int Stale;
+  int MaxAge;
+  char Location[LINE_SIZE];
+  char HostAddr[LINE_SIZE];
+  int NumEntries;
+  SsdpPacketEntry *Entries;
+} SsdpPacketCache;
+
+extern ithread_mutex_t gSsdpCacheMutex;
+
 typedef struct ssdpsearcharg
 {
   int timeoutEventId;
@@ -569,5 +602,70 @@ int AdvertiseAndReply(
 	IN char *DeviceUDN, 
 	IN char *ServiceType, int Exp);
 
-#endif
+/************************************************************************
+* Function : SsdpPacketCacheBuild
+*
+* Parameters:
+*	IN struct Handle_Info *SInfo: Device handle info
+*	IN int Exp: max-age to put in the packets
+*
+* Description:
+*	This function walks the description document of the device once and
+*	builds every ssdp:alive and search reply packet the device can send.
+*	The new set replaces the current one; a set still in use by a
+*	sending thread is freed when that thread releases it.
+*
+* Returns: int
+*	UPNP_E_SUCCESS if successful else appropriate error
+***************************************************************************/
+struct Handle_Info;
+int SsdpPacketCacheBuild(
+	IN struct Handle_Info *SInfo,
+	IN int Exp);
 
+/************************************************************************
+* Function : SsdpPacketCacheInvalidate
+*
+* Parameters:
+*	IN struct Handle_Info *SInfo: Device handle info
+*
+* Description:
+*	This function drops the precomputed packets of the device. It must be
+*	called when the description document or the device address changes;
+*	the next advertisement or reply rebuilds them.
+*
+* Returns: void
+***************************************************************************/
+void SsdpPacketCacheInvalidate(IN struct Handle_Info *SInfo);
+
+/************************************************************************
+* Function : SsdpSendCachedPackets
+*
+* Parameters:
+*	IN int AdFlag: 0 = send reply, 1 = send advertisement
+*	IN struct Handle_Info *SInfo: Device handle info
+*	IN enum SsdpSearchType SearchType: Search type for sending replies
+*	IN struct sockaddr_in *DestAddr: Destination address of replies
+*	IN char *DeviceType: Device type
+*	IN char *DeviceUDN: Device UDN
+*	IN char *ServiceType: Service type
+*	IN int Exp: Advertisement age
+*
+* Description:
+*	This function sends advertisements or search replies from the
+*	precomputed packet set of the device, through a single socket.
+*
+* Returns: int
+*	UPNP_E_SUCCESS if successful else appropriate error
+***************************************************************************/
+int SsdpSendCachedPackets(
+	IN int AdFlag,
+	IN struct Handle_Info *SInfo,
+	IN enum SsdpSearchType SearchType,
+	IN struct sockaddr_in *DestAddr,
+	IN char *DeviceType,
+	IN char *DeviceUDN,
+	IN char *ServiceType,
+	IN int Exp);
+
+#endif
@@ -88,6 +88,7 @@ struct Handle_Info
                                 //URL information
     int MaxSubscriptions;
     int MaxSubscriptionTimeOut;
+    struct SsdpPacketCache *SsdpCache; // precomputed SSDP packets
 #endif
      
     // Client only
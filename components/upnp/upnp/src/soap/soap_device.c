@@ -63,6 +63,26 @@
 #define SOAP_INVALID_VAR	404
 #define SOAP_ACTION_FAILED	501
 
+// what the streaming scan of a SOAP envelope keeps
+typedef enum {
+    SOAP_ARG_NONE,
+    SOAP_ARG_OPEN,
+    SOAP_ARG_DONE
+} soap_arg_state;
+
+typedef struct {
+    const char *entity;             // the envelope
+    int body_depth;                 // 0 until Body is seen
+    char body_ns[LINE_SIZE];
+    char action_node[NAME_SIZE];    // qualified name
+    char action_name[NAME_SIZE];    // local name
+    char action_ns[LINE_SIZE];
+    size_t action_start;            // offset of '<' plus one, 0 if none
+    size_t action_end;              // offset past the end tag, 0 if none
+    soap_arg_state arg_state;       // first argument of the action
+    char arg_value[LINE_SIZE];
+} soap_body_t;
+
 static const char *Soap_Invalid_Action = "Invalid Action";
 
 //static const char* Soap_Invalid_Args = "Invalid Args";
@@ -315,16 +335,170 @@ send_var_query_response( IN SOCKINFO * info,
     membuffer_destroy( &response );
 }
 
+/****************************************************************************
+*	Function :	soap_body_start
+*
+*	Parameters :
+*		IN void *cookie :	soap_body_t being filled in
+*		IN const IXML_SaxElement *element :	element just opened
+*
+*	Description :	Streaming parser callback. Locates the Body element
+*		of the envelope, then records the name, namespace and start offset
+*		of the action element (first child of Body) and spots its first
+*		argument.
+*
+*	Return : int
+*		IXML_SUCCESS to keep scanning.
+*
+*	Note :
+****************************************************************************/
+static int
+soap_body_start( IN void *cookie,
+                 IN const IXML_SaxElement * element )
+{
+    soap_body_t *body = ( soap_body_t * ) cookie;
+
+    if( body->body_depth == 0 ) {
+        if( element->depth == 2 && !strcmp( element->localName, SOAP_BODY ) ) {
+            body->body_depth = element->depth;
+            linecopy( body->body_ns, element->namespaceURI != NULL ?
+                      element->namespaceURI : "" );
+        }
+    } else if( element->depth == body->body_depth + 1 ) {
+        if( body->action_start == 0 ) {
+            namecopy( body->action_node, element->nodeName );
+            namecopy( body->action_name, element->localName );
+            linecopy( body->action_ns, element->namespaceURI != NULL ?
+                      element->namespaceURI : "" );
+            body->action_start = element->offset + 1;
+        }
+    } else if( element->depth == body->body_depth + 2 ) {
+        if( body->arg_state == SOAP_ARG_NONE ) {
+            body->arg_state = SOAP_ARG_OPEN;
+        }
+    }
+
+    return IXML_SUCCESS;
+}
+
+/****************************************************************************
+*	Function :	soap_body_chars
+*
+*	Parameters :
+*		IN void *cookie :	soap_body_t being filled in
+*		IN const char *text :	character data
+*		IN int depth :	depth of the enclosing element
+*
+*	Description :	Streaming parser callback. Keeps the text of the first
+*		argument of the action, which is the variable name of a
+*		QueryStateVariable request.
+*
+*	Return : int
+*		IXML_SUCCESS to keep scanning.
+*
+*	Note :
+****************************************************************************/
+static int
+soap_body_chars( IN void *cookie,
+                 IN const char *text,
+                 IN int depth )
+{
+    soap_body_t *body = ( soap_body_t * ) cookie;
+
+    if( body->arg_state == SOAP_ARG_OPEN && body->body_depth != 0 &&
+        depth == body->body_depth + 2 ) {
+        linecopy( body->arg_value, text );
+    }
+
+    return IXML_SUCCESS;
+}
+
+/****************************************************************************
+*	Function :	soap_body_end
+*
+*	Parameters :
+*		IN void *cookie :	soap_body_t being filled in
+*		IN const IXML_SaxElement *element :	element just closed
+*
+*	Description :	Streaming parser callback. Records where the action
+*		element ends and stops the scan there; nothing past it is needed.
+*
+*	Return : int
+*		IXML_SUCCESS to keep scanning, IXML_SAX_STOPPED once the action
+*		element is complete.
+*
+*	Note :
+****************************************************************************/
+static int
+soap_body_end( IN void *cookie,
+               IN const IXML_SaxElement * element )
+{
+    soap_body_t *body = ( soap_body_t * ) cookie;
+
+    if( body->body_depth == 0 ) {
+        return IXML_SUCCESS;
+    }
+
+    if( element->depth == body->body_depth + 2 &&
+        body->arg_state == SOAP_ARG_OPEN ) {
+        body->arg_state = SOAP_ARG_DONE;
+    } else if( element->depth == body->body_depth + 1 ) {
+        body->action_end = element->offset;
+        return IXML_SAX_STOPPED;
+    }
+
+    return IXML_SUCCESS;
+}
+
+/****************************************************************************
+*	Function :	parse_soap_body
+*
+*	Parameters :
+*		IN const char *entity :	SOAP envelope received in the request
+*		OUT soap_body_t *body :	what was found in the envelope
+*
+*	Description :	This function scans the SOAP envelope with the
+*		streaming XML parser, without building a DOM for it. Only the
+*		action element is kept, as a span of the entity.
+*
+*	Return : int
+*		IXML_SUCCESS if the envelope is well formed up to the end of the
+*		action element, else the ixml error code.
+*
+*	Note :
+****************************************************************************/
+static int
+parse_soap_body( IN const char *entity,
+                 OUT soap_body_t * body )
+{
+    static const IXML_SaxHandler handler = {
+        soap_body_start,
+        soap_body_chars,
+        soap_body_end
+    };
+    int ret_code;
+
+    memset( body, 0, sizeof( soap_body_t ) );
+    body->entity = entity;
+
+    ret_code = ixmlParseBufferSax( entity, &handler, body );
+    if( ret_code == IXML_SAX_STOPPED ) {
+        ret_code = IXML_SUCCESS;
+    }
+
+    return ret_code;
+}
+
 /****************************************************************************
 *	Function :	get_action_node
 *
 *	Parameters :
-*		IN IXML_Document *TempDoc :	The root DOM node.
+*		IN soap_body_t *body :	The scanned SOAP envelope.
 *		IN char *NodeName :	IXML_Node name to be searched.
 *		OUT IXML_Document ** RespNode :	Response/Output node.
 *
 *	Description :	This function separates the action node from 
-*	the root DOM node.
+*	the SOAP envelope, parsing only its span of the request.
 *
 *	Return :	static UPNP_INLINE int
 *		0 if successful, or -1 if fails.
@@ -332,76 +506,47 @@ send_var_query_response( IN SOCKINFO * info,
 *	Note :
 ****************************************************************************/
 static UPNP_INLINE int
-get_action_node( IN IXML_Document * TempDoc,
+get_action_node( IN soap_body_t * body,
                  IN char *NodeName,
                  OUT IXML_Document ** RespNode )
 {
-    IXML_Node *EnvpNode = NULL;
-    IXML_Node *BodyNode = NULL;
-    IXML_Node *ActNode = NULL;
-    DOMString ActNodeName = NULL;
-    const DOMString nodeName;
+    char *ActNodeText = NULL;
+    size_t len;
     int ret_code = -1;          // error, by default
-    IXML_NodeList *nl = NULL;
 
     UpnpPrintf( UPNP_INFO, SOAP, __FILE__, __LINE__,
         "get_action_node(): node name =%s\n ", NodeName );
 
     *RespNode = NULL;
 
-    // Got the Envelope node here
-    EnvpNode = ixmlNode_getFirstChild( ( IXML_Node * ) TempDoc );
-    if( EnvpNode == NULL ) {
-        goto error_handler;
-    }
-
-    nl = ixmlElement_getElementsByTagNameNS( ( IXML_Element * ) EnvpNode,
-                                             "*", "Body" );
-
-    if( nl == NULL ) {
-        goto error_handler;
-    }
-
-    BodyNode = ixmlNodeList_item( nl, 0 );
-
-    if( BodyNode == NULL ) {
-        goto error_handler;
-    }
     // Got action node here
-    ActNode = ixmlNode_getFirstChild( BodyNode );
-    if( ActNode == NULL ) {
+    if( body->action_start == 0 || body->action_end == 0 ) {
         goto error_handler;
     }
     //Test whether this is the action node
-    nodeName = ixmlNode_getNodeName( ActNode );
-    if( nodeName == NULL ) {
+    if( strstr( body->action_node, NodeName ) == NULL ) {
         goto error_handler;
     }
 
-    if( strstr( nodeName, NodeName ) == NULL ) {
+    len = body->action_end - ( body->action_start - 1 );
+    ActNodeText = ( char * )os_alloc( len + 1 );
+    if( ActNodeText == NULL ) {
         goto error_handler;
-    } else {
-        ActNodeName = ixmlPrintNode( ActNode );
-        if( ActNodeName == NULL ) {
-            goto error_handler;
-        }
+    }
+    memcpy( ActNodeText, body->entity + body->action_start - 1, len );
+    ActNodeText[len] = '\0';
 
-        ret_code = ixmlParseBufferEx( ActNodeName, RespNode );
-        if( ret_code != IXML_SUCCESS ) {
-            ixmlFreeDOMString( ActNodeName );
-            ret_code = -1;
-            goto error_handler;
-        }
+    if( ixmlParseBufferEx( ActNodeText, RespNode ) != IXML_SUCCESS ) {
+        goto error_handler;
     }
 
     ret_code = 0;               // success
 
   error_handler:
 
-    ixmlFreeDOMString( ActNodeName );
-
-    if( nl )
-        ixmlNodeList_free( nl );
+    if( ActNodeText != NULL ) {
+        os_free( ActNodeText );
+    }
     return ret_code;
 }
 
@@ -409,7 +554,7 @@ get_action_node( IN IXML_Document * TempDoc,
 *	Function :	check_soap_body
 *
 *	Parameters :
-*		IN IXML_Document *doc :	soap body xml document
+*		IN soap_body_t *body :	the scanned SOAP envelope
 *		    IN const char *urn : 
 *		    IN const char *actionName : Name of the requested action 	
 *
@@ -422,35 +567,18 @@ get_action_node( IN IXML_Document * TempDoc,
 *	Note :
 ****************************************************************************/
 static int
-check_soap_body( IN IXML_Document * doc,
+check_soap_body( IN soap_body_t * body,
                  IN const char *urn,
                  IN const char *actionName )
 {
-    IXML_NodeList *nl = NULL;
-    IXML_Node *bodyNode = NULL;
-    IXML_Node *actionNode = NULL;
-    const DOMString ns = NULL;
-    const DOMString name = NULL;
-
     int ret_code = UPNP_E_INVALID_ACTION;
 
-    nl = ixmlDocument_getElementsByTagNameNS( doc, SOAP_URN, SOAP_BODY );
-
-    if( nl ) {
-        bodyNode = ixmlNodeList_item( nl, 0 );
-        if( bodyNode ) {
-            actionNode = ixmlNode_getFirstChild( bodyNode );
-            if( actionNode ) {
-                ns = ixmlNode_getNamespaceURI( actionNode );
-                name = ixmlNode_getLocalName( actionNode );
-
-                if( ( !strcmp( actionName, name ) )
-                    && ( !strcmp( urn, ns ) ) ) {
-                    ret_code = UPNP_E_SUCCESS;
-                }
-            }
+    if( body->body_depth != 0 && !strcmp( body->body_ns, SOAP_URN ) &&
+        body->action_start != 0 ) {
+        if( ( !strcmp( actionName, body->action_name ) )
+            && ( !strcmp( urn, body->action_ns ) ) ) {
+            ret_code = UPNP_E_SUCCESS;
         }
-        ixmlNodeList_free( nl );
     }
     return ret_code;
 
@@ -568,7 +696,7 @@ check_soap_action_header( IN http_message_t * request,
 *	Parameters :
 *		IN http_message_t* request :	HTTP request
 *		IN int isQuery :	flag for a querry
-*		IN IXML_Document *actionDoc :	action request document
+*		IN soap_body_t *body :	the scanned SOAP envelope
 *		OUT char device_udn[LINE_SIZE] :	Device UDN string
 *		OUT char service_id[LINE_SIZE] :	Service ID string
 *		OUT Upnp_FunPtr *callback :	callback function of the device 
@@ -588,7 +716,7 @@ check_soap_action_header( IN http_message_t * request,
 static int
 get_device_info( IN http_message_t * request,
                  IN int isQuery,
-                 IN IXML_Document * actionDoc,
+                 IN soap_body_t * body,
                  OUT char device_udn[LINE_SIZE],
                  OUT char service_id[LINE_SIZE],
                  OUT Upnp_FunPtr * callback,
@@ -629,7 +757,7 @@ get_device_info( IN http_message_t * request,
         }
         //check soap body
         ret_code =
-            check_soap_body( actionDoc, QUERY_STATE_VAR_URN, actionName );
+            check_soap_body( body, QUERY_STATE_VAR_URN, actionName );
         os_free( actionName );
         if( ret_code != UPNP_E_SUCCESS ) {
             goto error_handler;
@@ -645,7 +773,7 @@ get_device_info( IN http_message_t * request,
         }
         //check soap body
         ret_code =
-            check_soap_body( actionDoc, serv_info->serviceType,
+            check_soap_body( body, serv_info->serviceType,
                              actionName );
         os_free( actionName );
         if( ret_code != UPNP_E_SUCCESS ) {
@@ -759,7 +887,7 @@ error_handler:
 *	Function :	get_var_name
 *
 *	Parameters :
-*		IN IXML_Document *TempDoc :	Document containing variable request
+*		IN soap_body_t *body :	the scanned variable request
 *		OUT char* VarName :	Name of the state varible
 *
 *	Description :	This function finds the name of the state variable 
@@ -770,48 +898,22 @@ error_handler:
 *	Note :
 ****************************************************************************/
 static UPNP_INLINE int
-get_var_name( IN IXML_Document * TempDoc,
+get_var_name( IN soap_body_t * body,
               OUT char *VarName )
 {
-    IXML_Node *EnvpNode = NULL;
-    IXML_Node *BodyNode = NULL;
-    IXML_Node *StNode = NULL;
-    IXML_Node *VarNameNode = NULL;
-    IXML_Node *VarNode = NULL;
-    const DOMString StNodeName = NULL;
-    const DOMString Temp = NULL;
     int ret_val = -1;
 
-    // Got the Envelop node here
-    EnvpNode = ixmlNode_getFirstChild( ( IXML_Node * ) TempDoc );
-    if( EnvpNode == NULL ) {
-        goto error_handler;
-    }
-    // Got Body here
-    BodyNode = ixmlNode_getFirstChild( EnvpNode );
-    if( BodyNode == NULL ) {
-        goto error_handler;
-    }
-    // Got action node here
-    StNode = ixmlNode_getFirstChild( BodyNode );
-    if( StNode == NULL ) {
-        goto error_handler;
-    }
     //Test whether this is the action node
-    StNodeName = ixmlNode_getNodeName( StNode );
-    if( StNodeName == NULL || strstr( StNodeName,
-                                      "QueryStateVariable" ) == NULL ) {
+    if( body->action_start == 0 ||
+        strstr( body->action_node, "QueryStateVariable" ) == NULL ) {
         goto error_handler;
     }
 
-    VarNameNode = ixmlNode_getFirstChild( StNode );
-    if( VarNameNode == NULL ) {
+    if( body->arg_state == SOAP_ARG_NONE ) {
         goto error_handler;
     }
 
-    VarNode = ixmlNode_getFirstChild( VarNameNode );
-    Temp = ixmlNode_getNodeValue( VarNode );
-    linecopy( VarName, Temp );
+    linecopy( VarName, body->arg_value );
 
     UpnpPrintf( UPNP_INFO, SOAP, __FILE__, __LINE__,
         "Received query for variable  name %s\n",
@@ -829,8 +931,7 @@ error_handler:
 *	Parameters :
 *		IN SOCKINFO *info :	Socket info
 *		IN http_message_t* request : HTTP request	
-*		IN IXML_Document *xml_doc :	Document containing the variable request 
-*									SOAP message
+*		IN soap_body_t *body :	the scanned variable request SOAP message
 *
 *	Description :	This action handles the SOAP requests to querry the 
 *				state variables. This functionality has been deprecated in 
@@ -843,7 +944,7 @@ error_handler:
 static UPNP_INLINE void
 handle_query_variable( IN SOCKINFO * info,
                        IN http_message_t * request,
-                       IN IXML_Document * xml_doc )
+                       IN soap_body_t * body )
 {
     Upnp_FunPtr soap_event_callback;
     void *cookie;
@@ -853,13 +954,13 @@ handle_query_variable( IN SOCKINFO * info,
     int err_code;
 
     // get var name
-    if( get_var_name( xml_doc, var_name ) != 0 ) {
+    if( get_var_name( body, var_name ) != 0 ) {
         send_error_response( info, SOAP_INVALID_VAR,
                              Soap_Invalid_Var, request );
         return;
     }
     // get info for event
-    if( get_device_info( request, 1, xml_doc, variable.DevUDN,
+    if( get_device_info( request, 1, body, variable.DevUDN,
                          variable.ServiceID,
                          &soap_event_callback, &cookie ) != 0 ) {
         send_error_response( info, SOAP_INVALID_VAR,
@@ -911,8 +1012,7 @@ handle_query_variable( IN SOCKINFO * info,
 *		IN SOCKINFO *info :	Socket info
 *		IN http_message_t* request : HTTP Request	
 *		IN memptr action_name :	 Name of the SOAP Action
-*		IN IXML_Document *xml_doc :	document containing the SOAP action 
-*									request
+*		IN soap_body_t *body :	the scanned SOAP action request
 *
 *	Description :	This functions handle the SOAP action request. It checks 
 *		the integrity of the SOAP action request and gives the call back to 
@@ -926,7 +1026,7 @@ static void
 handle_invoke_action( IN SOCKINFO * info,
                       IN http_message_t * request,
                       IN memptr action_name,
-                      IN IXML_Document * xml_doc )
+                      IN soap_body_t * body )
 {
     char save_char;
     IXML_Document *resp_node = NULL;
@@ -947,11 +1047,11 @@ handle_invoke_action( IN SOCKINFO * info,
     err_str = Soap_Invalid_Action;
 
     // get action node
-    if( get_action_node( xml_doc, action_name.buf, &resp_node ) == -1 ) {
+    if( get_action_node( body, action_name.buf, &resp_node ) == -1 ) {
         goto error_handler;
     }
     // get device info for action event
-    err_code = get_device_info( request, 0, xml_doc, action.DevUDN,
+    err_code = get_device_info( request, 0, body, action.DevUDN,
                                 action.ServiceID, &soap_event_callback,
                                 &cookie );
 
@@ -1027,7 +1127,7 @@ soap_device_callback( IN http_parser_t * parser,
     int err_code;
     const char *err_str;
     memptr action_name;
-    IXML_Document *xml_doc = NULL;
+    soap_body_t *body = NULL;
 
     // set default error
     err_code = SOAP_INVALID_ACTION;
@@ -1041,8 +1141,13 @@ soap_device_callback( IN http_parser_t * parser,
     if( get_request_type( request, &action_name ) != 0 ) {
         goto error_handler;
     }
-    // parse XML
-    err_code = ixmlParseBufferEx( request->entity.buf, &xml_doc );
+    // scan XML; only the action element ends up in a DOM
+    body = ( soap_body_t * ) os_alloc( sizeof( soap_body_t ) );
+    if( body == NULL ) {
+        err_code = UPNP_E_OUTOF_MEMORY;
+        goto error_handler;
+    }
+    err_code = parse_soap_body( request->entity.buf, body );
     if( err_code != IXML_SUCCESS ) {
         if( err_code == IXML_INSUFFICIENT_MEMORY ) {
             err_code = UPNP_E_OUTOF_MEMORY;
@@ -1056,16 +1161,18 @@ soap_device_callback( IN http_parser_t * parser,
 
     if( action_name.length == 0 ) {
         // query var
-        handle_query_variable( info, request, xml_doc );
+        handle_query_variable( info, request, body );
     } else {
         // invoke action
-        handle_invoke_action( info, request, action_name, xml_doc );
+        handle_invoke_action( info, request, action_name, body );
     }
 
     err_code = 0;               // no error
 
   error_handler:
-    ixmlDocument_free( xml_doc );
+    if( body != NULL ) {
+        os_free( body );
+    }
     if( err_code != 0 ) {
         send_error_response( info, err_code, err_str, request );
     }
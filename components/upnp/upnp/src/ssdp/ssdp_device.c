@@ -51,6 +51,15 @@
 #define MSGTYPE_ADVERTISEMENT	1
 #define MSGTYPE_REPLY		2
 
+// protects the SSDP packet caches and the search reply schedule
+ithread_mutex_t gSsdpCacheMutex;
+
+// number of search replies currently scheduled on the timer thread
+static int gSsdpPendingReplies = 0;
+
+// earliest time (os_systime) at which the next search reply may go out
+static uint32_t gSsdpNextReplyTime = 0;
+
 /************************************************************************
 * Function : advertiseAndReplyThread
 *
@@ -77,6 +86,10 @@ advertiseAndReplyThread( IN void *data )
                        arg->event.ServiceType, arg->MaxAge );
     os_free( arg );
 
+    ithread_mutex_lock( &gSsdpCacheMutex );
+    gSsdpPendingReplies--;
+    ithread_mutex_unlock( &gSsdpCacheMutex );
+
     return NULL;
 }
 
@@ -91,6 +104,10 @@ advertiseAndReplyThread( IN void *data )
 *	This function handles the search request. It do the sanity checks of
 *	the request and then schedules a thread to send a random time reply (
 *	random within maximum time given by the control point to reply).
+*	Replies are kept at least SSDP_REPLY_INTERVAL ms apart and at most
+*	SSDP_MAX_PENDING_REPLIES are outstanding, so a burst of searches
+*	after a network event is answered over the MX window instead of
+*	all at once.
 *
 * Returns: void *
 *	1 if successful else appropriate error
@@ -111,7 +128,9 @@ ssdp_handle_device_request( IN http_message_t * hmsg,
     int ret_code;
     SsdpSearchReply *threadArg = NULL;
     ThreadPoolJob job;
-    int replyTime;
+    uint32_t now;
+    uint32_t replyTime;
+    uint32_t window;
     int maxAge;
 
     // check man hdr
@@ -186,10 +205,40 @@ ssdp_handle_device_request( IN http_message_t * hmsg,
         mx = 1;
     }
 
-    replyTime = rand() % mx;
+    // timer thread runs in milliseconds, MX is in seconds
+    window = ( uint32_t ) mx * 1000;
+
+    ithread_mutex_lock( &gSsdpCacheMutex );
+    if( gSsdpPendingReplies >= SSDP_MAX_PENDING_REPLIES ) {
+        ithread_mutex_unlock( &gSsdpCacheMutex );
+        os_free( threadArg );
+        return;                 // control point will retry the search
+    }
 
-    TimerThreadSchedule( &gTimerThread, replyTime, REL_SEC, &job,
-                         SHORT_TERM, NULL );
+    now = os_systime();
+    replyTime = now + ( uint32_t ) rand() % window;
+    if( ( int32_t )( replyTime - gSsdpNextReplyTime ) < 0 ) {
+        replyTime = gSsdpNextReplyTime;
+    }
+    if( replyTime - now >= window ) {
+        ithread_mutex_unlock( &gSsdpCacheMutex );
+        os_free( threadArg );
+        return;                 // no free slot left inside the MX window
+    }
+    if( ( int32_t )( replyTime + SSDP_REPLY_INTERVAL -
+                     gSsdpNextReplyTime ) > 0 ) {
+        gSsdpNextReplyTime = replyTime + SSDP_REPLY_INTERVAL;
+    }
+    gSsdpPendingReplies++;
+    ithread_mutex_unlock( &gSsdpCacheMutex );
+
+    if( TimerThreadSchedule( &gTimerThread, replyTime - now, REL_SEC, &job,
+                             SHORT_TERM, NULL ) != 0 ) {
+        ithread_mutex_lock( &gSsdpCacheMutex );
+        gSsdpPendingReplies--;
+        ithread_mutex_unlock( &gSsdpCacheMutex );
+        os_free( threadArg );
+    }
 }
 #endif
 
@@ -357,6 +406,508 @@ CreateServicePacket( IN int msg_type,
     return;
 }
 
+/************************************************************************
+* Function : SsdpPacketCacheFree
+*
+* Parameters:
+*	IN SsdpPacketCache *cache: packet set to free
+*
+* Description:
+*	This function frees a packet set and all its packets.
+*
+* Returns: void
+***************************************************************************/
+static void
+SsdpPacketCacheFree( IN SsdpPacketCache *cache )
+{
+    int i;
+
+    if( cache == NULL ) {
+        return;
+    }
+    for( i = 0; i < cache->NumEntries; i++ ) {
+        os_free( cache->Entries[i].Udn );
+        os_free( cache->Entries[i].Target );
+        os_free( cache->Entries[i].Alive );
+        os_free( cache->Entries[i].Reply );
+    }
+    os_free( cache->Entries );
+    os_free( cache );
+}
+
+/************************************************************************
+* Function : SsdpPacketCacheRetire
+*
+* Parameters:
+*	IN SsdpPacketCache *cache: packet set no longer attached to a handle
+*
+* Description:
+*	This function marks a packet set stale and frees it once no sending
+*	thread holds it. gSsdpCacheMutex must be held.
+*
+* Returns: void
+***************************************************************************/
+static void
+SsdpPacketCacheRetire( IN SsdpPacketCache *cache )
+{
+    if( cache == NULL ) {
+        return;
+    }
+    cache->Stale = 1;
+    if( cache->RefCount == 0 ) {
+        SsdpPacketCacheFree( cache );
+    }
+}
+
+/************************************************************************
+* Function : SsdpPacketCacheAdd
+*
+* Parameters:
+*	IN SsdpPacketCache *cache: packet set being built
+*	IN int *capacity: number of entries allocated in cache->Entries
+*	IN int Kind: SSDP_PKT_xxx
+*	IN int RootDev: 1 if the entry belongs to the root device
+*	IN char *Udn: Device UDN
+*	IN char *Target: NT/ST value of the packets
+*	IN char *Usn: USN value of the packets
+*
+* Description:
+*	This function creates the ssdp:alive and the search reply packet of
+*	one NT/USN pair and appends them to the packet set.
+*
+* Returns: int
+*	UPNP_E_SUCCESS if successful else UPNP_E_OUTOF_MEMORY
+***************************************************************************/
+static int
+SsdpPacketCacheAdd( IN SsdpPacketCache *cache,
+                    IN int *capacity,
+                    IN int Kind,
+                    IN int RootDev,
+                    IN char *Udn,
+                    IN char *Target,
+                    IN char *Usn )
+{
+    SsdpPacketEntry *entry;
+    SsdpPacketEntry *entries;
+
+    if( cache->NumEntries == *capacity ) {
+        entries = os_realloc( cache->Entries,
+                              sizeof( SsdpPacketEntry ) * ( *capacity + 8 ) );
+        if( entries == NULL ) {
+            return UPNP_E_OUTOF_MEMORY;
+        }
+        cache->Entries = entries;
+        *capacity += 8;
+    }
+
+    entry = &cache->Entries[cache->NumEntries];
+    memset( entry, 0, sizeof( SsdpPacketEntry ) );
+    entry->Kind = Kind;
+    entry->RootDev = RootDev;
+    entry->Udn = str_alloc( Udn, strlen( Udn ) );
+    entry->Target = str_alloc( Target, strlen( Target ) );
+    CreateServicePacket( MSGTYPE_ADVERTISEMENT, Target, Usn,
+                         cache->Location, cache->MaxAge, &entry->Alive );
+    CreateServicePacket( MSGTYPE_REPLY, Target, Usn,
+                         cache->Location, cache->MaxAge, &entry->Reply );
+
+    // count the entry even when incomplete so that it gets freed
+    cache->NumEntries++;
+
+    if( entry->Udn == NULL || entry->Target == NULL ||
+        entry->Alive == NULL || entry->Reply == NULL ) {
+        return UPNP_E_OUTOF_MEMORY;
+    }
+
+    return UPNP_E_SUCCESS;
+}
+
+/************************************************************************
+* Function : GetElementText
+*
+* Parameters:
+*	IN IXML_Element *element: element to search in
+*	IN char *tag: tag name of the wanted child element
+*	OUT char *buf: buffer receiving the text value
+*	IN size_t size: size of buf
+*
+* Description:
+*	This function copies the text of the first descendant of element
+*	named tag into buf.
+*
+* Returns: int
+*	0 if found, -1 otherwise
+***************************************************************************/
+static int
+GetElementText( IN IXML_Element *element,
+                IN char *tag,
+                OUT char *buf,
+                IN size_t size )
+{
+    IXML_NodeList *nodeList;
+    IXML_Node *textNode = NULL;
+    const DOMString value = NULL;
+
+    nodeList = ixmlElement_getElementsByTagName( element, tag );
+    if( nodeList == NULL ) {
+        return -1;
+    }
+    textNode = ixmlNode_getFirstChild( ixmlNodeList_item( nodeList, 0 ) );
+    if( textNode != NULL ) {
+        value = ixmlNode_getNodeValue( textNode );
+    }
+    if( value != NULL ) {
+        snprintf( buf, size, "%s", value );
+    }
+    ixmlNodeList_free( nodeList );
+
+    return value != NULL ? 0 : -1;
+}
+
+/************************************************************************
+* Function : SsdpPacketCacheBuild
+*
+* Parameters:
+*	IN struct Handle_Info *SInfo: Device handle info
+*	IN int Exp: max-age to put in the packets
+*
+* Description:
+*	This function walks the description document of the device once and
+*	builds every ssdp:alive and search reply packet the device can send.
+*	The new set replaces the current one; a set still in use by a
+*	sending thread is freed when that thread releases it.
+*
+* Returns: int
+*	UPNP_E_SUCCESS if successful else appropriate error
+***************************************************************************/
+int
+SsdpPacketCacheBuild( IN struct Handle_Info *SInfo,
+                      IN int Exp )
+{
+    SsdpPacketCache *cache;
+    SsdpPacketCache *old;
+    IXML_NodeList *nodeList;
+    IXML_Node *devNode;
+    IXML_Node *servNode;
+    char *UDNstr;
+    char *devType;
+    char *servType;
+    char *usn;
+    int capacity = 0;
+    int ret_code = UPNP_E_SUCCESS;
+    int i,
+      j;
+
+    cache = ( SsdpPacketCache * ) os_alloc( sizeof( SsdpPacketCache ) );
+    UDNstr = os_alloc( LINE_SIZE );
+    devType = os_alloc( LINE_SIZE );
+    servType = os_alloc( LINE_SIZE );
+    usn = os_alloc( LINE_SIZE );
+    if( cache == NULL || UDNstr == NULL || devType == NULL ||
+        servType == NULL || usn == NULL ) {
+        ret_code = UPNP_E_OUTOF_MEMORY;
+        goto out;
+    }
+
+    memset( cache, 0, sizeof( SsdpPacketCache ) );
+    cache->MaxAge = Exp;
+    snprintf( cache->Location, LINE_SIZE, "%s", SInfo->DescURL );
+    snprintf( cache->HostAddr, LINE_SIZE, "%s", LOCAL_HOST );
+
+    for( i = 0;; i++ ) {
+        devNode = ixmlNodeList_item( SInfo->DeviceList, i );
+        if( devNode == NULL ) {
+            break;
+        }
+        if( GetElementText( ( IXML_Element * ) devNode, "deviceType",
+                            devType, LINE_SIZE ) != 0 ||
+            GetElementText( ( IXML_Element * ) devNode, "UDN",
+                            UDNstr, LINE_SIZE ) != 0 ) {
+            continue;
+        }
+
+        // same packets and order as DeviceAdvertisement()/DeviceReply()
+        if( i == 0 ) {
+            snprintf( usn, LINE_SIZE, "%s::upnp:rootdevice", UDNstr );
+            ret_code = SsdpPacketCacheAdd( cache, &capacity,
+                                           SSDP_PKT_ROOTDEVICE, 1, UDNstr,
+                                           "upnp:rootdevice", usn );
+            if( ret_code != UPNP_E_SUCCESS ) {
+                goto out;
+            }
+        }
+        ret_code = SsdpPacketCacheAdd( cache, &capacity,
+                                       SSDP_PKT_DEVICEUDN, i == 0, UDNstr,
+                                       UDNstr, UDNstr );
+        if( ret_code != UPNP_E_SUCCESS ) {
+            goto out;
+        }
+        snprintf( usn, LINE_SIZE, "%s::%s", UDNstr, devType );
+        ret_code = SsdpPacketCacheAdd( cache, &capacity,
+                                       SSDP_PKT_DEVICETYPE, i == 0, UDNstr,
+                                       devType, usn );
+        if( ret_code != UPNP_E_SUCCESS ) {
+            goto out;
+        }
+
+        // services of the same device
+        servNode = ixmlNodeList_item( SInfo->ServiceList, i );
+        if( servNode == NULL ) {
+            continue;
+        }
+        nodeList = ixmlElement_getElementsByTagName(
+            ( IXML_Element * ) servNode, "service" );
+        if( nodeList == NULL ) {
+            continue;
+        }
+        for( j = 0;; j++ ) {
+            servNode = ixmlNodeList_item( nodeList, j );
+            if( servNode == NULL ) {
+                break;
+            }
+            if( GetElementText( ( IXML_Element * ) servNode, "serviceType",
+                                servType, LINE_SIZE ) != 0 ) {
+                continue;
+            }
+            snprintf( usn, LINE_SIZE, "%s::%s", UDNstr, servType );
+            ret_code = SsdpPacketCacheAdd( cache, &capacity,
+                                           SSDP_PKT_SERVICE, i == 0, UDNstr,
+                                           servType, usn );
+            if( ret_code != UPNP_E_SUCCESS ) {
+                break;
+            }
+        }
+        ixmlNodeList_free( nodeList );
+        if( ret_code != UPNP_E_SUCCESS ) {
+            goto out;
+        }
+    }
+
+    ithread_mutex_lock( &gSsdpCacheMutex );
+    old = SInfo->SsdpCache;
+    SInfo->SsdpCache = cache;
+    SsdpPacketCacheRetire( old );
+    ithread_mutex_unlock( &gSsdpCacheMutex );
+    cache = NULL;
+
+out:
+    SsdpPacketCacheFree( cache );
+    os_free( UDNstr );
+    os_free( devType );
+    os_free( servType );
+    os_free( usn );
+
+    return ret_code;
+}
+
+/************************************************************************
+* Function : SsdpPacketCacheInvalidate
+*
+* Parameters:
+*	IN struct Handle_Info *SInfo: Device handle info
+*
+* Description:
+*	This function drops the precomputed packets of the device. It must be
+*	called when the description document or the device address changes;
+*	the next advertisement or reply rebuilds them.
+*
+* Returns: void
+***************************************************************************/
+void
+SsdpPacketCacheInvalidate( IN struct Handle_Info *SInfo )
+{
+    ithread_mutex_lock( &gSsdpCacheMutex );
+    SsdpPacketCacheRetire( SInfo->SsdpCache );
+    SInfo->SsdpCache = NULL;
+    ithread_mutex_unlock( &gSsdpCacheMutex );
+}
+
+/************************************************************************
+* Function : SsdpPacketCacheGet
+*
+* Parameters:
+*	IN struct Handle_Info *SInfo: Device handle info
+*	IN int Exp: max-age the packets must carry
+*
+* Description:
+*	This function returns a referenced packet set matching the current
+*	description URL, host address and max-age of the device, rebuilding
+*	it if needed. Release it with SsdpPacketCachePut().
+*
+* Returns: SsdpPacketCache *
+*	packet set, or NULL if it could not be built
+***************************************************************************/
+static SsdpPacketCache *
+SsdpPacketCacheGet( IN struct Handle_Info *SInfo,
+                    IN int Exp )
+{
+    SsdpPacketCache *cache;
+    int attempt;
+
+    for( attempt = 0; attempt < 2; attempt++ ) {
+        ithread_mutex_lock( &gSsdpCacheMutex );
+        cache = SInfo->SsdpCache;
+        if( cache != NULL && cache->MaxAge == Exp &&
+            strcmp( cache->Location, SInfo->DescURL ) == 0 &&
+            strcmp( cache->HostAddr, LOCAL_HOST ) == 0 ) {
+            cache->RefCount++;
+            ithread_mutex_unlock( &gSsdpCacheMutex );
+            return cache;
+        }
+        ithread_mutex_unlock( &gSsdpCacheMutex );
+
+        if( attempt == 0 &&
+            SsdpPacketCacheBuild( SInfo, Exp ) != UPNP_E_SUCCESS ) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/************************************************************************
+* Function : SsdpPacketCachePut
+*
+* Parameters:
+*	IN SsdpPacketCache *cache: packet set returned by SsdpPacketCacheGet
+*
+* Description:
+*	This function releases a packet set reference.
+*
+* Returns: void
+***************************************************************************/
+static void
+SsdpPacketCachePut( IN SsdpPacketCache *cache )
+{
+    ithread_mutex_lock( &gSsdpCacheMutex );
+    cache->RefCount--;
+    if( cache->Stale && cache->RefCount == 0 ) {
+        SsdpPacketCacheFree( cache );
+    }
+    ithread_mutex_unlock( &gSsdpCacheMutex );
+}
+
+/************************************************************************
+* Function : SsdpPacketMatch
+*
+* Parameters:
+*	IN SsdpPacketEntry *entry: precomputed packet pair
+*	IN enum SsdpSearchType SearchType: Search type
+*	IN char *DeviceType: Device type searched for
+*	IN char *DeviceUDN: Device UDN searched for
+*	IN char *ServiceType: Service type searched for
+*
+* Description:
+*	This function tells whether the reply of entry answers a search,
+*	with the same rules AdvertiseAndReply() applies to the DOM.
+*
+* Returns: int
+*	1 if the entry matches, 0 otherwise
+***************************************************************************/
+static int
+SsdpPacketMatch( IN SsdpPacketEntry *entry,
+                 IN enum SsdpSearchType SearchType,
+                 IN char *DeviceType,
+                 IN char *DeviceUDN,
+                 IN char *ServiceType )
+{
+    switch ( SearchType ) {
+        case SSDP_ALL:
+            return 1;
+        case SSDP_ROOTDEVICE:
+            return entry->Kind == SSDP_PKT_ROOTDEVICE;
+        case SSDP_DEVICEUDN:
+            if( DeviceUDN != NULL && strlen( DeviceUDN ) != 0 ) {
+                return entry->Kind == SSDP_PKT_DEVICEUDN &&
+                    strcasecmp( DeviceUDN, entry->Udn ) == 0;
+            }
+            // an empty UDN is searched by device type
+        case SSDP_DEVICETYPE:
+            return entry->Kind == SSDP_PKT_DEVICETYPE &&
+                strncasecmp( DeviceType, entry->Target,
+                             strlen( DeviceType ) ) == 0;
+        case SSDP_SERVICE:
+            return entry->Kind == SSDP_PKT_SERVICE && ServiceType != NULL &&
+                strncasecmp( ServiceType, entry->Target,
+                             strlen( ServiceType ) ) == 0;
+        default:
+            return 0;
+    }
+}
+
+/************************************************************************
+* Function : SsdpSendCachedPackets
+*
+* Parameters:
+*	IN int AdFlag: 0 = send reply, 1 = send advertisement
+*	IN struct Handle_Info *SInfo: Device handle info
+*	IN enum SsdpSearchType SearchType: Search type for sending replies
+*	IN struct sockaddr_in *DestAddr: Destination address of replies
+*	IN char *DeviceType: Device type
+*	IN char *DeviceUDN: Device UDN
+*	IN char *ServiceType: Service type
+*	IN int Exp: Advertisement age
+*
+* Description:
+*	This function sends advertisements or search replies from the
+*	precomputed packet set of the device, through a single socket.
+*
+* Returns: int
+*	UPNP_E_SUCCESS if successful else appropriate error
+***************************************************************************/
+int
+SsdpSendCachedPackets( IN int AdFlag,
+                       IN struct Handle_Info *SInfo,
+                       IN enum SsdpSearchType SearchType,
+                       IN struct sockaddr_in *DestAddr,
+                       IN char *DeviceType,
+                       IN char *DeviceUDN,
+                       IN char *ServiceType,
+                       IN int Exp )
+{
+    SsdpPacketCache *cache;
+    struct sockaddr_in McastAddr;
+    char **msgs;
+    int num_msgs = 0;
+    int ret_code = UPNP_E_SUCCESS;
+    int i;
+
+    cache = SsdpPacketCacheGet( SInfo, Exp );
+    if( cache == NULL ) {
+        return UPNP_E_OUTOF_MEMORY;
+    }
+
+    msgs = ( char ** )os_alloc( sizeof( char * ) * ( cache->NumEntries + 1 ) );
+    if( msgs == NULL ) {
+        SsdpPacketCachePut( cache );
+        return UPNP_E_OUTOF_MEMORY;
+    }
+
+    for( i = 0; i < cache->NumEntries; i++ ) {
+        if( AdFlag == 1 ) {
+            msgs[num_msgs++] = cache->Entries[i].Alive;
+        } else if( SsdpPacketMatch( &cache->Entries[i], SearchType,
+                                    DeviceType, DeviceUDN, ServiceType ) ) {
+            msgs[num_msgs++] = cache->Entries[i].Reply;
+        }
+    }
+
+    if( AdFlag == 1 ) {
+        McastAddr.sin_family = AF_INET;
+        McastAddr.sin_addr.s_addr = inet_addr( SSDP_IP );
+        McastAddr.sin_port = htons( SSDP_PORT );
+        DestAddr = &McastAddr;
+    }
+    if( num_msgs > 0 ) {
+        ret_code = NewRequestHandler( DestAddr, num_msgs, msgs );
+    }
+
+    os_free( msgs );
+    SsdpPacketCachePut( cache );
+
+    return ret_code;
+}
+
 /************************************************************************
 * Function : DeviceAdvertisement
 *
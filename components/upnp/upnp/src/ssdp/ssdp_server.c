@@ -102,6 +102,7 @@ int AdvertiseAndReply( IN int AdFlag,
 {
     int i,
       j;
+    int retVal;
     int defaultExp = DEFAULT_MAXAGE;
     struct Handle_Info *SInfo = NULL;
     char UDNstr[100],
@@ -131,6 +132,19 @@ int AdvertiseAndReply( IN int AdFlag,
     }
     defaultExp = SInfo->MaxAge;
 
+    // advertisements and replies go out from the packet set built at
+    // registration; the description is only walked again for shutdown
+    // or when that set cannot be allocated
+    if( AdFlag != -1 ) {
+        retVal = SsdpSendCachedPackets( AdFlag, SInfo, SearchType, DestAddr,
+                                        DeviceType, DeviceUDN, ServiceType,
+                                        AdFlag == 1 ? Exp : defaultExp );
+        if( retVal != UPNP_E_OUTOF_MEMORY ) {
+            os_free(SERVER);
+            return retVal;
+        }
+    }
+
     //get server info
     get_sdk_info( SERVER );
 
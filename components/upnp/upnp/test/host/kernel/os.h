@@ -0,0 +1,7 @@
+// Host stand-in for the kernel header, for building parser tests on Linux.
+#include <stdint.h>
+#include <stdlib.h>
+
+#define os_alloc	malloc
+#define os_free		free
+#define os_realloc	realloc
@@ -0,0 +1,2 @@
+// Host stand-in for the lwIP header, for building parser tests on Linux.
+#include <netdb.h>
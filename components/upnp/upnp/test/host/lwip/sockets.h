@@ -0,0 +1,4 @@
+// Host stand-in for the lwIP header, for building parser tests on Linux.
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
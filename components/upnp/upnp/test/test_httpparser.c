@@ -0,0 +1,408 @@
+///////////////////////////////////////////////////////////////////////////
+//
+// HTTP parser conformance, fuzz and benchmark run on the host.
+//
+// Every sample message is fed to the parser whole, one byte at a time,
+// in small chunks and split in two at every position, and the parsed
+// headers and entity are checked each time. Random mutations of the
+// samples are then fed in random sized pieces to shake out reads past
+// the buffer (build with -fsanitize=address). Last, each sample is
+// parsed in a loop to time the parser and count its heap allocations.
+//
+// See test_httpparser.sh for the build.
+//
+///////////////////////////////////////////////////////////////////////////
+
+#include "httpparser.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FUZZ_ROUNDS	20000
+#define BENCH_ROUNDS	20000
+
+static unsigned long n_alloc;
+
+#ifndef __SANITIZE_ADDRESS__
+// count allocations; left to the sanitizer in checked builds
+extern void *__libc_malloc (size_t size);
+extern void *__libc_realloc (void *p, size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void __libc_free (void *p);
+
+void *
+malloc (size_t size)
+{
+	n_alloc++;
+	return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+	n_alloc++;
+	return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *p, size_t size)
+{
+	n_alloc++;
+	return __libc_realloc (p, size);
+}
+
+void
+free (void *p)
+{
+	__libc_free (p);
+}
+#endif
+
+typedef struct {
+	int		id;	// HDR_ id, or HDR_UNKNOWN to look up by name
+	const char	*name;
+	const char	*value;	// NULL if the header must be absent
+} expect_t;
+
+typedef struct {
+	const char	*title;
+	int		is_request;
+	http_method_t	request_method;	// responses only
+	const char	*text;
+	const char	*entity;	// NULL if not checked
+	expect_t	hdrs[12];
+} sample_t;
+
+static const sample_t samples[] = {
+	{ "M-SEARCH", 1, 0,
+	  "M-SEARCH * HTTP/1.1\r\n"
+	  "HOST: 239.255.255.250:1900\r\n"
+	  "MAN: \"ssdp:discover\"\r\n"
+	  "MX: 3\r\n"
+	  "ST: upnp:rootdevice\r\n"
+	  "\r\n",
+	  NULL,
+	  { { HDR_HOST, "HOST", "239.255.255.250:1900" },
+	    { HDR_MAN, "man", "\"ssdp:discover\"" },
+	    { HDR_MX, "Mx", "3" },
+	    { HDR_ST, "ST", "upnp:rootdevice" },
+	    { HDR_NT, "NT", NULL },
+	    { HDR_UNKNOWN, "X-NONE", NULL } } },
+
+	{ "SUBSCRIBE, bare LF and folded value", 1, 0,
+	  "SUBSCRIBE /upnp/event/tv HTTP/1.1\n"
+	  "Host: 10.0.0.1:49152\n"
+	  "Callback: <http://10.0.0.2:5000/ev>\n"
+	  "NT:upnp:event\n"
+	  "Timeout:\n"
+	  "  Second-1800\n"
+	  "\n",
+	  NULL,
+	  { { HDR_CALLBACK, "CALLBACK", "<http://10.0.0.2:5000/ev>" },
+	    { HDR_NT, "nt", "upnp:event" },
+	    { HDR_TIMEOUT, "TIMEOUT", "Second-1800" },
+	    { HDR_SID, "SID", NULL } } },
+
+	{ "SOAP POST", 1, 0,
+	  "POST /upnp/control/tv HTTP/1.1\r\n"
+	  "HOST: 10.0.0.1:49152\r\n"
+	  "CONTENT-LENGTH: 25\r\n"
+	  "CONTENT-TYPE: text/xml; charset=\"utf-8\"\r\n"
+	  "SOAPACTION: \"urn:schemas-upnp-org:service:tvcontrol:1#PowerOn\"\r\n"
+	  "USER-AGENT: Linux/5.0, UPnP/1.0, test/1.0\r\n"
+	  "01-SOAPACTION: urn:x#y\r\n"
+	  "\r\n"
+	  "<s:Envelope></s:Envelope>",
+	  "<s:Envelope></s:Envelope>",
+	  { { HDR_CONTENT_LENGTH, "Content-Length", "25" },
+	    { HDR_CONTENT_TYPE, "content-type",
+	      "text/xml; charset=\"utf-8\"" },
+	    { HDR_SOAPACTION, "SOAPACTION",
+	      "\"urn:schemas-upnp-org:service:tvcontrol:1#PowerOn\"" },
+	    { HDR_USER_AGENT, "USER-AGENT",
+	      "Linux/5.0, UPnP/1.0, test/1.0" },
+	    { HDR_UNKNOWN, "01-soapaction", "urn:x#y" } } },
+
+	{ "duplicate and unknown headers", 1, 0,
+	  "GET /desc.xml HTTP/1.1\r\n"
+	  "Host: 10.0.0.1\r\n"
+	  "Accept: text/xml\r\n"
+	  "X-Extra: one \r\n"
+	  "ACCEPT: text/plain\r\n"
+	  "x-extra:\ttwo\r\n"
+	  "X-Empty:\r\n"
+	  "\r\n",
+	  NULL,
+	  { { HDR_ACCEPT, "ACCEPT", "text/xml, text/plain" },
+	    { HDR_UNKNOWN, "X-EXTRA", "one, two" },
+	    { HDR_UNKNOWN, "X-Empty", "" } } },
+
+	{ "chunked response with trailer", 0, HTTPMETHOD_GET,
+	  "HTTP/1.1 200 OK\r\n"
+	  "TRANSFER-ENCODING: chunked\r\n"
+	  "CONTENT-TYPE: text/xml\r\n"
+	  "\r\n"
+	  "5\r\nhello\r\n"
+	  "6\r\n world\r\n"
+	  "0\r\n"
+	  "X-Trailer: done\r\n"
+	  "\r\n",
+	  "hello world",
+	  { { HDR_TRANSFER_ENCODING, "TRANSFER-ENCODING", "chunked" },
+	    { HDR_CONTENT_TYPE, "CONTENT-TYPE", "text/xml" },
+	    { HDR_UNKNOWN, "X-Trailer", "done" } } },
+};
+
+#define NUM_SAMPLES	( sizeof (samples) / sizeof (samples[0]) )
+
+static int n_fail;
+
+static void
+init_parser (http_parser_t *parser, const sample_t *s)
+{
+	if (s->is_request)
+		parser_request_init (parser);
+	else
+		parser_response_init (parser, s->request_method);
+}
+
+/*
+ * Feeds 'len' bytes of 's' to the parser, 'step' bytes at a time, with
+ * the first piece cut at 'split' if that is not 0.
+ */
+static parse_status_t
+feed (http_parser_t *parser, const sample_t *s, size_t len,
+      size_t split, size_t step)
+{
+	parse_status_t status = PARSE_INCOMPLETE;
+	size_t pos = 0;
+	size_t n;
+
+	while (pos < len) {
+		n = pos == 0 && split != 0 ? split : step;
+		if (n > len - pos)
+			n = len - pos;
+		status = parser_append (parser, s->text + pos, n);
+		pos += n;
+		if (status != PARSE_INCOMPLETE &&
+		    status != PARSE_INCOMPLETE_ENTITY)
+			break;
+	}
+	return status;
+}
+
+static int
+same (const memptr *m, const char *str)
+{
+	return m->length == strlen (str) &&
+		memcmp (m->buf, str, m->length) == 0;
+}
+
+static void
+check (const sample_t *s, size_t split, size_t step)
+{
+	http_parser_t parser;
+	parse_status_t status;
+	http_header_t *hdr;
+	const expect_t *e;
+	memptr value;
+
+	init_parser (&parser, s);
+	status = feed (&parser, s, strlen (s->text), split, step);
+
+	if (status != PARSE_SUCCESS) {
+		printf ("FAIL %s (split %zu, step %zu): status %d\n",
+			s->title, split, step, status);
+		n_fail++;
+		goto done;
+	}
+
+	for (e = s->hdrs; e->name != NULL; e++) {
+		if (e->id != HDR_UNKNOWN) {
+			hdr = httpmsg_find_hdr (&parser.msg, e->id, &value);
+		} else {
+			hdr = httpmsg_find_hdr_str (&parser.msg, e->name);
+			if (hdr != NULL) {
+				value.buf = hdr->value.buf;
+				value.length = hdr->value.length;
+			}
+		}
+		if ((hdr == NULL) != (e->value == NULL) ||
+		    (hdr != NULL && !same (&value, e->value))) {
+			printf ("FAIL %s (split %zu, step %zu): %s = '%.*s'\n",
+				s->title, split, step, e->name,
+				hdr ? (int) value.length : 4,
+				hdr ? value.buf : "NULL");
+			n_fail++;
+		}
+
+		// lookup by name finds the same header as lookup by id
+		if (e->id != HDR_UNKNOWN &&
+		    httpmsg_find_hdr_str (&parser.msg, e->name) != hdr) {
+			printf ("FAIL %s: find_hdr_str(%s)\n", s->title,
+				e->name);
+			n_fail++;
+		}
+	}
+
+	if (s->entity != NULL && !same (&parser.msg.entity, s->entity)) {
+		printf ("FAIL %s (split %zu, step %zu): entity '%.*s'\n",
+			s->title, split, step, (int) parser.msg.entity.length,
+			parser.msg.entity.buf);
+		n_fail++;
+	}
+
+done:
+	httpmsg_destroy (&parser.msg);
+}
+
+static void
+run_conformance (void)
+{
+	size_t i, len, split;
+	static const size_t steps[] = { 1, 2, 3, 7, 64 };
+
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		len = strlen (samples[i].text);
+		for (split = 0; split < sizeof (steps) / sizeof (steps[0]);
+		     split++)
+			check (&samples[i], 0, steps[split]);
+		for (split = 1; split < len; split++)
+			check (&samples[i], split, len);
+	}
+}
+
+static unsigned long rng = 0x2545F491;
+
+static unsigned long
+rand_next (void)
+{
+	rng ^= rng << 13;
+	rng ^= rng >> 17;
+	rng ^= rng << 5;
+	return rng & 0xffffffff;
+}
+
+static void
+run_fuzz (void)
+{
+	static const char interesting[] = ":  \t\r\n\r\n\"\\0aZ\x80\xff";
+	char buf[1024];
+	http_parser_t parser;
+	parse_status_t status;
+	const sample_t *s;
+	memptr value;
+	size_t len, pos, n;
+	unsigned long sum = 0;
+	int round, k, id;
+
+	for (round = 0; round < FUZZ_ROUNDS; round++) {
+		s = &samples[rand_next () % NUM_SAMPLES];
+		len = strlen (s->text);
+		memcpy (buf, s->text, len);
+
+		for (k = rand_next () % 8; k >= 0; k--) {
+			pos = rand_next () % len;
+			switch (rand_next () % 4) {
+			case 0:
+				buf[pos] = interesting[rand_next () %
+						       (sizeof (interesting) - 1)];
+				break;
+			case 1:
+				buf[pos] = (char) rand_next ();
+				break;
+			case 2:
+				memmove (buf + pos, buf + pos + 1,
+					 len - pos - 1);
+				len--;
+				break;
+			default:
+				n = rand_next () % 16;
+				if (len + n < sizeof (buf) && pos + n <= len) {
+					memmove (buf + pos + n, buf + pos,
+						 len - pos);
+					len += n;
+				}
+				break;
+			}
+			if (len < 2)
+				break;
+		}
+
+		init_parser (&parser, s);
+		status = PARSE_INCOMPLETE;
+		for (pos = 0; pos < len; pos += n) {
+			n = 1 + rand_next () % 32;
+			if (n > len - pos)
+				n = len - pos;
+			status = parser_append (&parser, buf + pos, n);
+			if (status != PARSE_INCOMPLETE &&
+			    status != PARSE_INCOMPLETE_ENTITY)
+				break;
+		}
+
+		// touch every value the parser hands out
+		for (id = 0; id < NUM_HDR_IDS; id++) {
+			if (httpmsg_find_hdr (&parser.msg, id, &value) != NULL)
+				for (n = 0; n < value.length; n++)
+					sum += (unsigned char) value.buf[n];
+		}
+		if (status == PARSE_SUCCESS)
+			for (n = 0; n < parser.msg.entity.length; n++)
+				sum += (unsigned char) parser.msg.entity.buf[n];
+		httpmsg_destroy (&parser.msg);
+	}
+
+	printf ("fuzz: %d messages (checksum %lu)\n", FUZZ_ROUNDS, sum);
+}
+
+static void
+run_bench (void)
+{
+	http_parser_t parser;
+	const sample_t *s;
+	struct timespec t0, t1;
+	unsigned long allocs;
+	double ns;
+	size_t i;
+	int round;
+
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		s = &samples[i];
+		allocs = n_alloc;
+		clock_gettime (CLOCK_MONOTONIC, &t0);
+		for (round = 0; round < BENCH_ROUNDS; round++) {
+			init_parser (&parser, s);
+			parser_append (&parser, s->text, strlen (s->text));
+			httpmsg_find_hdr (&parser.msg, HDR_HOST, NULL);
+			httpmsg_find_hdr (&parser.msg, HDR_SID, NULL);
+			httpmsg_find_hdr (&parser.msg, HDR_SOAPACTION, NULL);
+			httpmsg_destroy (&parser.msg);
+		}
+		clock_gettime (CLOCK_MONOTONIC, &t1);
+		ns = (t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec);
+		printf ("bench: %-36s %7.0f ns/msg %5.1f allocs/msg\n",
+			s->title, ns / BENCH_ROUNDS,
+			(double) (n_alloc - allocs) / BENCH_ROUNDS);
+	}
+}
+
+int
+main (int argc, char* argv[])
+{
+	run_conformance ();
+	if (n_fail != 0) {
+		printf ("%d checks failed\n", n_fail);
+		return 1;
+	}
+	printf ("conformance: OK\n");
+
+	run_fuzz ();
+
+	if (argc > 1 && strcmp (argv[1], "-b") == 0)
+		run_bench ();
+
+	return 0;
+}
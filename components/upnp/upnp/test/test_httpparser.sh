@@ -0,0 +1,30 @@
+#!/bin/sh
+#
+# Builds the HTTP parser with the host compiler and runs the conformance
+# and fuzz tests of test_httpparser under AddressSanitizer. With -b, an
+# optimized build also runs the benchmark.
+#
+srcdir=${srcdir:-`dirname $0`/..}
+CC=${CC:-cc}
+
+build() {
+	$CC "$@" -w -D_GNU_SOURCE \
+		-Dos_alloc=malloc -Dos_free=free -Dos_realloc=realloc \
+		-I$srcdir/test/host -I$srcdir/inc -I$srcdir/src/inc \
+		-I$srcdir/../ixml/inc -I$srcdir/../threadutil/inc -I$srcdir/.. \
+		$srcdir/src/genlib/net/http/httpparser.c \
+		$srcdir/src/genlib/net/uri/uri.c \
+		$srcdir/src/genlib/util/membuffer.c \
+		$srcdir/src/genlib/util/strintmap.c \
+		$srcdir/../threadutil/src/LinkedList.c \
+		$srcdir/../threadutil/src/FreeList.c \
+		$srcdir/test/test_httpparser.c
+}
+
+build -g -O1 -fsanitize=address -o test_httpparser || exit 1
+./test_httpparser || exit 1
+
+if [ "$1" = "-b" ]; then
+	build -O2 -DNDEBUG -o bench_httpparser || exit 1
+	./bench_httpparser -b
+fi